@@ -24,21 +24,29 @@ END_JUCE_MODULE_DECLARATION
 #include <clap-juce-extensions/clap-juce-extensions.h>
 
 using vec = xsimd::batch<double>;
+using fvec = xsimd::batch<float>;
 
 namespace strix
 {
 using namespace juce;
+#include "modules/FastMath.h"
+#include "modules/LookupTable.h"
+#include "modules/ADAA.h"
+#include "modules/Dispatch.h"
 #include "modules/Buffer.h"
-#include "modules/Slice.h"
 #include "modules/SIMD.h"
-#include "modules/FastMath.h"
+#include "modules/Slice.h"
 #include "modules/VolumeMeter.h"
+#include "modules/LevelHistory.h"
+#include "modules/Spectrum.h"
 #include "modules/Filter.h"
 #include "modules/IIRFilter.h"
 #include "modules/SVTFilter.h"
 #include "modules/LRFilter.h"
 #include "modules/ReleasePool.h"
 #include "modules/Delay.h"
+#include "modules/Oversampling.h"
+#include "modules/LoudnessMeter.h"
 #include "modules/RingBuffer.h"
 #include "modules/Parameter.h"
 #include "modules/SmoothGain.h"
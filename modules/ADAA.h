@@ -0,0 +1,340 @@
+/**
+ * ADAA.h
+ * Antiderivative anti-aliasing for the FastMath waveshapers
+ *
+ * Instead of evaluating f(x) at each sample, ADAA averages f over the line between the
+ * previous input and this one, using the antiderivatives F1 (and F2). That's a continuous
+ * time lowpass on the nonlinearity, which suppresses most of the aliasing oversampling
+ * would without running anything at a higher rate. First order adds half a sample of
+ * latency and rolls off the top octave slightly, second order adds one sample and more.
+ *
+ * Works on scalars or xsimd registers, where each lane is handled on its own.
+*/
+#pragma once
+
+namespace adaa
+{
+/* std:: for scalars & xsimd:: for registers */
+template <typename T>
+inline T log(T x) noexcept
+{
+    if constexpr (xsimd::is_batch<T>::value)
+        return xsimd::log(x);
+    else
+        return std::log(x);
+}
+
+template <typename T>
+inline T log1p(T x) noexcept
+{
+    if constexpr (xsimd::is_batch<T>::value)
+        return xsimd::log1p(x);
+    else
+        return std::log1p(x);
+}
+
+template <typename T>
+inline T exp(T x) noexcept
+{
+    if constexpr (xsimd::is_batch<T>::value)
+        return xsimd::exp(x);
+    else
+        return std::exp(x);
+}
+
+template <typename T>
+inline T sign(T x) noexcept
+{
+    return fast_math::select(x < T(0), fast_math::constant<T>(-1.0), fast_math::constant<T>(1.0));
+}
+
+/* ifTrue() or ifFalse(). Scalars only evaluate the branch they need, registers evaluate
+both and blend, so both have to be safe to compute for every lane */
+template <typename Cond, typename TrueFn, typename FalseFn>
+inline auto choose(const Cond &cond, TrueFn &&ifTrue, FalseFn &&ifFalse) noexcept
+{
+    if constexpr (std::is_same_v<Cond, bool>)
+        return cond ? ifTrue() : ifFalse();
+    else
+        return xsimd::select(cond, ifTrue(), ifFalse());
+}
+
+/* Li2(-e^-2x) for x >= 0, from the Bernoulli series in u = -log(1 + e^-2x), |u| <= ln2 */
+template <typename T>
+inline T dilogOfMinusExp(T x) noexcept
+{
+    const auto u = -adaa::log1p(adaa::exp(fast_math::constant<T>(-2.0) * x));
+    const auto u2 = u * u;
+    const auto odd = fast_math::horner(u2, {1.0 / 36.0, -1.0 / 3600.0, 1.0 / 211680.0, -1.0 / 10886400.0,
+                                            1.0 / 526901760.0, -4.0647616451442256e-11, 8.921691020456452e-13});
+    return u + u2 * (fast_math::constant<T>(-0.25) + u * odd);
+}
+
+/* Each shape is a struct of the function & its first two antiderivatives, with the
+constants picked so F1(0) = F2(0) = 0, which keeps the differences better conditioned */
+
+/* tanh, via the type-picked tanh() wrapper */
+struct Tanh
+{
+    template <typename T>
+    static T f(T x) noexcept { return strix::tanh(x); }
+
+    /* log(cosh(x)), written so it can't overflow */
+    template <typename T>
+    static T F1(T x) noexcept
+    {
+        const auto ax = strix::abs(x);
+        return ax + adaa::log1p(adaa::exp(fast_math::constant<T>(-2.0) * ax)) - fast_math::constant<T>(0.69314718055994530942);
+    }
+
+    /* x^2/2 - x ln2 + Li2(-e^-2x)/2 + pi^2/24 for x >= 0, & odd */
+    template <typename T>
+    static T F2(T x) noexcept
+    {
+        const auto ax = strix::abs(x);
+        const auto y = ax * (fast_math::constant<T>(0.5) * ax - fast_math::constant<T>(0.69314718055994530942))
+                     + fast_math::constant<T>(0.5) * dilogOfMinusExp(ax) + fast_math::constant<T>(0.41123351671205660911);
+        return sign(x) * y;
+    }
+};
+
+/* fast_tanh(), integrated exactly. The denominator is a cubic in x^2 with 3 negative
+roots, so in partial fractions the rational part integrates to logs (F1) and then to
+logs & atans (F2). Mind that fast_tanh keeps growing (as x/28) outside about +/-5, and
+these follow it there */
+struct FastTanh
+{
+    template <typename T>
+    static T f(T x) noexcept { return fast_tanh(x); }
+
+    template <typename T>
+    static T F1(T x) noexcept
+    {
+        const auto x2 = x * x;
+        auto y = x2 * fast_math::constant<T>(1.0 / 28.0);
+
+        for (size_t i = 0; i < 3; ++i)
+            y += fast_math::constant<T>(weights[i]) * adaa::log1p(x2 * fast_math::constant<T>(1.0 / roots[i]));
+
+        return fast_math::constant<T>(0.5) * y;
+    }
+
+    template <typename T>
+    static T F2(T x) noexcept
+    {
+        const auto x2 = x * x;
+        auto y = x2 * x * fast_math::constant<T>(1.0 / 84.0);
+
+        // integral of log(1 + x^2/a) = x log(1 + x^2/a) - 2x + 2 sqrt(a) atan(x / sqrt(a))
+        for (size_t i = 0; i < 3; ++i)
+        {
+            const auto term = x * (adaa::log1p(x2 * fast_math::constant<T>(1.0 / roots[i])) - fast_math::constant<T>(2.0))
+                            + fast_math::constant<T>(2.0 * sqrtRoots[i]) * strix::atan(x * fast_math::constant<T>(1.0 / sqrtRoots[i]));
+            y += fast_math::constant<T>(weights[i]) * term;
+        }
+
+        return fast_math::constant<T>(0.5) * y;
+    }
+
+private:
+    // denominator = 28 (x^2 + a0)(x^2 + a1)(x^2 + a2)
+    static constexpr double roots[3] = {87.739192978953078572, 22.293405912300319517, 2.4674011087466019109};
+    static constexpr double sqrtRoots[3] = {9.3669201437267030099, 4.7215893417683329395, 1.5707963294923380712};
+    static constexpr double weights[3] = {5.4366737688927574104, 2.0454690378987320686, 2.0000000503513676639};
+};
+
+/* atan, via the type-picked atan() wrapper */
+struct Atan
+{
+    template <typename T>
+    static T f(T x) noexcept { return strix::atan(x); }
+
+    template <typename T>
+    static T F1(T x) noexcept
+    {
+        return x * strix::atan(x) - fast_math::constant<T>(0.5) * adaa::log1p(x * x);
+    }
+
+    template <typename T>
+    static T F2(T x) noexcept
+    {
+        const auto x2 = x * x;
+        return fast_math::constant<T>(0.5) * ((x2 - fast_math::constant<T>(1.0)) * strix::atan(x) + x - x * adaa::log1p(x2));
+    }
+};
+
+/* clip to [-1, 1] */
+struct HardClip
+{
+    template <typename T>
+    static T f(T x) noexcept
+    {
+        return fast_math::clamp(x, fast_math::constant<T>(-1.0), fast_math::constant<T>(1.0));
+    }
+
+    template <typename T>
+    static T F1(T x) noexcept
+    {
+        const auto ax = strix::abs(x);
+        return fast_math::select(ax <= T(1), fast_math::constant<T>(0.5) * x * x, ax - fast_math::constant<T>(0.5));
+    }
+
+    template <typename T>
+    static T F2(T x) noexcept
+    {
+        const auto ax = strix::abs(x);
+        const auto inside = x * x * x * fast_math::constant<T>(1.0 / 6.0);
+        const auto outside = sign(x) * (fast_math::constant<T>(0.5) * x * x + fast_math::constant<T>(1.0 / 6.0))
+                           - fast_math::constant<T>(0.5) * x;
+        return fast_math::select(ax <= T(1), inside, outside);
+    }
+};
+
+/* Below this distance between inputs, the divided differences are mostly rounding error
+and the shape is evaluated directly instead. Float needs a much bigger margin, and
+second-order ADAA in float is noticeably noisier than in double */
+template <typename T>
+constexpr double tolerance = std::is_same_v<fast_math::ScalarType<T>, float> ? 1.0e-3 : 1.0e-5;
+}
+
+/// @brief First-order ADAA of one of the shapes in adaa (Tanh, FastTanh, Atan, HardClip),
+/// y[n] = (F1(x[n]) - F1(x[n-1])) / (x[n] - x[n-1])
+/// @tparam T sample data type (float/double/xsimd register)
+/// @tparam Shape adaa::Tanh, adaa::FastTanh, adaa::Atan or adaa::HardClip
+template <typename T, class Shape>
+class FirstOrderADAA
+{
+    struct State
+    {
+        T x1 = T(0), F1x1 = T(0);
+    };
+
+    std::vector<State> state{2};
+
+public:
+    void prepare(const dsp::ProcessSpec &spec)
+    {
+        state.resize(spec.numChannels);
+        reset();
+    }
+
+    void reset()
+    {
+        std::fill(state.begin(), state.end(), State{});
+    }
+
+    inline T processSample(size_t ch, T x) noexcept
+    {
+        jassert(ch < state.size());
+        auto &s = state[ch];
+
+        const auto F1x = Shape::F1(x);
+        const auto delta = x - s.x1;
+        const auto illConditioned = strix::abs(delta) < T(adaa::tolerance<T>);
+
+        const auto y = adaa::choose(illConditioned,
+            [&] { return Shape::f(fast_math::constant<T>(0.5) * (x + s.x1)); },
+            [&] { return (F1x - s.F1x1) / fast_math::select(illConditioned, T(1), delta); });
+
+        s.x1 = x;
+        s.F1x1 = F1x;
+
+        return y;
+    }
+
+    void processChannel(T *in, size_t ch, size_t numSamples) noexcept
+    {
+        for (size_t i = 0; i < numSamples; ++i)
+            in[i] = processSample(ch, in[i]);
+    }
+
+    template <class Block>
+    void processBlock(Block &block) noexcept
+    {
+        for (size_t ch = 0; ch < block.getNumChannels(); ++ch)
+            processChannel(block.getChannelPointer(ch), ch, block.getNumSamples());
+    }
+};
+
+/// @brief Second-order ADAA of one of the shapes in adaa, after Bilbao et al.,
+/// "Antiderivative Antialiasing for Memoryless Nonlinearities" (2017):
+/// y[n] = 2 / (x[n] - x[n-2]) * (D1[n] - D1[n-1]), with D1 the divided difference of F2
+/// @tparam T sample data type (float/double/xsimd register)
+/// @tparam Shape adaa::Tanh, adaa::FastTanh, adaa::Atan or adaa::HardClip
+template <typename T, class Shape>
+class SecondOrderADAA
+{
+    struct State
+    {
+        T x1 = T(0), x2 = T(0), F2x1 = T(0), D1 = T(0);
+    };
+
+    std::vector<State> state{2};
+
+public:
+    void prepare(const dsp::ProcessSpec &spec)
+    {
+        state.resize(spec.numChannels);
+        reset();
+    }
+
+    void reset()
+    {
+        std::fill(state.begin(), state.end(), State{});
+    }
+
+    inline T processSample(size_t ch, T x) noexcept
+    {
+        jassert(ch < state.size());
+        auto &s = state[ch];
+        const T tol(adaa::tolerance<T>);
+        const auto half = fast_math::constant<T>(0.5);
+
+        // D1[n], the first-order difference of F2
+        const auto F2x = Shape::F2(x);
+        const auto delta1 = x - s.x1;
+        const auto ill1 = strix::abs(delta1) < tol;
+        const auto D1 = adaa::choose(ill1,
+            [&] { return Shape::F1(half * (x + s.x1)); },
+            [&] { return (F2x - s.F2x1) / fast_math::select(ill1, T(1), delta1); });
+
+        const auto delta2 = x - s.x2;
+        const auto ill2 = strix::abs(delta2) < tol;
+
+        const auto y = adaa::choose(ill2,
+            [&] {
+                // x[n] ~ x[n-2], so treat both as their mean & difference against x[n-1] instead
+                const auto xBar = half * (x + s.x2);
+                const auto delta = xBar - s.x1;
+                const auto ill = strix::abs(delta) < tol;
+
+                return adaa::choose(ill,
+                    [&] { return Shape::f(half * (xBar + s.x1)); },
+                    [&] {
+                        const auto d = fast_math::select(ill, T(1), delta);
+                        return T(2) / d * (Shape::F1(xBar) + (s.F2x1 - Shape::F2(xBar)) / d);
+                    });
+            },
+            [&] { return T(2) / fast_math::select(ill2, T(1), delta2) * (D1 - s.D1); });
+
+        s.x2 = s.x1;
+        s.x1 = x;
+        s.F2x1 = F2x;
+        s.D1 = D1;
+
+        return y;
+    }
+
+    void processChannel(T *in, size_t ch, size_t numSamples) noexcept
+    {
+        for (size_t i = 0; i < numSamples; ++i)
+            in[i] = processSample(ch, in[i]);
+    }
+
+    template <class Block>
+    void processBlock(Block &block) noexcept
+    {
+        for (size_t ch = 0; ch < block.getNumChannels(); ++ch)
+            processChannel(block.getChannelPointer(ch), ch, block.getNumSamples());
+    }
+};
@@ -2,23 +2,368 @@
  * Custom class for xsimd-compatible buffers
  */
 #pragma once
-namespace buffer_clear
+/**
+ * Vectorized kernels for the arithmetic Buffer does on every block.
+ * Scalar sample types are processed xsimd::batch::size lanes at a time, with a scalar tail,
+ * or through the runtime-dispatched kernels in Dispatch.h if STRIX_RUNTIME_DISPATCH is on.
+ * If the sample type is already an xsimd register, each element is one register's worth
+ * and the loops are left as-is.
+ */
+namespace buffer_ops
+{
+template <typename Type, typename = void>
+struct Numeric { using type = Type; };
+
+template <typename Type>
+struct Numeric<Type, std::enable_if_t<xsimd::is_batch<Type>::value>> { using type = typename Type::value_type; };
+
+template <typename Type>
+using NumericType = typename Numeric<Type>::type;
+
+template <typename Type>
+void clear(Type* dest, size_t numSamples) noexcept
 {
+    if constexpr (std::is_floating_point_v<Type>)
+        juce::FloatVectorOperations::clear(dest, (int)numSamples);
+    else
+        std::fill(dest, dest + numSamples, Type{});
+}
+
+template <typename Type>
+void multiply(Type* dest, NumericType<Type> gain, size_t numSamples) noexcept
+{
+#if STRIX_RUNTIME_DISPATCH
+    if constexpr (std::is_floating_point_v<Type>)
+        return dispatch::getKernels<Type>().multiply(dest, gain, numSamples);
+#endif
+
+    size_t i = 0;
+
+    if constexpr (std::is_floating_point_v<Type>)
+    {
+        using b_type = xsimd::batch<Type>;
+        const auto vecEnd = numSamples - numSamples % b_type::size;
+        const b_type g(gain);
+
+        for (; i < vecEnd; i += b_type::size)
+            (b_type::load_unaligned(dest + i) * g).store_unaligned(dest + i);
+    }
+
+    for (; i < numSamples; ++i)
+        dest[i] *= gain;
+}
+
+template <typename Type>
+void multiply(Type* dest, const Type* source, size_t numSamples) noexcept
+{
+#if STRIX_RUNTIME_DISPATCH
+    if constexpr (std::is_floating_point_v<Type>)
+        return dispatch::getKernels<Type>().multiplyBy(dest, source, numSamples);
+#endif
+
+    size_t i = 0;
+
+    if constexpr (std::is_floating_point_v<Type>)
+    {
+        using b_type = xsimd::batch<Type>;
+        const auto vecEnd = numSamples - numSamples % b_type::size;
+
+        for (; i < vecEnd; i += b_type::size)
+            (b_type::load_unaligned(dest + i) * b_type::load_unaligned(source + i)).store_unaligned(dest + i);
+    }
+
+    for (; i < numSamples; ++i)
+        dest[i] *= source[i];
+}
+
+/* multiplies dest by a gain ramping linearly from startGain towards endGain */
+template <typename Type>
+void gainRamp(Type* dest, NumericType<Type> startGain, NumericType<Type> endGain, size_t numSamples) noexcept
+{
+#if STRIX_RUNTIME_DISPATCH
+    if constexpr (std::is_floating_point_v<Type>)
+        return dispatch::getKernels<Type>().gainRamp(dest, startGain, endGain, numSamples);
+#endif
+
+    using N = NumericType<Type>;
+    if (numSamples == 0)
+        return;
+
+    const auto inc = (endGain - startGain) / (N)numSamples;
+    size_t i = 0;
+
+    if constexpr (std::is_floating_point_v<Type>)
+    {
+        using b_type = xsimd::batch<Type>;
+        const auto vecEnd = numSamples - numSamples % b_type::size;
+
+        alignas(b_type::arch_type::alignment()) Type offsets[b_type::size];
+        for (size_t j = 0; j < b_type::size; ++j)
+            offsets[j] = (Type)j;
+
+        const auto step = b_type(inc * (N)b_type::size);
+        auto g = b_type(startGain) + b_type::load_aligned(offsets) * inc;
+
+        for (; i < vecEnd; i += b_type::size)
+        {
+            (b_type::load_unaligned(dest + i) * g).store_unaligned(dest + i);
+            g += step;
+        }
+    }
+
+    for (; i < numSamples; ++i)
+        dest[i] *= startGain + inc * (N)i;
+}
+
+/* dest += source * gain */
+template <typename Type>
+void addWithGain(Type* dest, const Type* source, NumericType<Type> gain, size_t numSamples) noexcept
+{
+#if STRIX_RUNTIME_DISPATCH
+    if constexpr (std::is_floating_point_v<Type>)
+        return dispatch::getKernels<Type>().addWithGain(dest, source, gain, numSamples);
+#endif
+
+    size_t i = 0;
+
+    if constexpr (std::is_floating_point_v<Type>)
+    {
+        using b_type = xsimd::batch<Type>;
+        const auto vecEnd = numSamples - numSamples % b_type::size;
+        const b_type g(gain);
+
+        for (; i < vecEnd; i += b_type::size)
+            xsimd::fma(b_type::load_unaligned(source + i), g, b_type::load_unaligned(dest + i)).store_unaligned(dest + i);
+    }
+
+    for (; i < numSamples; ++i)
+        dest[i] += source[i] * gain;
+}
+
+/* dest = source * gain */
+template <typename Type>
+void copyWithGain(Type* dest, const Type* source, NumericType<Type> gain, size_t numSamples) noexcept
+{
+    size_t i = 0;
+
+    if constexpr (std::is_floating_point_v<Type>)
+    {
+        using b_type = xsimd::batch<Type>;
+        const auto vecEnd = numSamples - numSamples % b_type::size;
+        const b_type g(gain);
+
+        for (; i < vecEnd; i += b_type::size)
+            (b_type::load_unaligned(source + i) * g).store_unaligned(dest + i);
+    }
+
+    for (; i < numSamples; ++i)
+        dest[i] = source[i] * gain;
+}
+
+/* returns the largest absolute sample value, across all lanes if Type is an xsimd register */
+template <typename Type>
+NumericType<Type> maxAbs(const Type* source, size_t numSamples) noexcept
+{
+    using N = NumericType<Type>;
+    N result = 0;
+    size_t i = 0;
+
+    if constexpr (std::is_floating_point_v<Type>)
+    {
+        using b_type = xsimd::batch<Type>;
+        const auto vecEnd = numSamples - numSamples % b_type::size;
+        b_type m(0);
+
+        for (; i < vecEnd; i += b_type::size)
+            m = xsimd::max(m, xsimd::abs(b_type::load_unaligned(source + i)));
+
+        result = xsimd::reduce_max(m);
+
+        for (; i < numSamples; ++i)
+            result = jmax(result, std::abs(source[i]));
+    }
+    else
+    {
+        Type m(0);
+        for (; i < numSamples; ++i)
+            m = xsimd::max(m, xsimd::abs(source[i]));
+
+        result = xsimd::reduce_max(m);
+    }
+
+    return result;
+}
+
+/* largest absolute sample value & sum of squares in one pass, across all lanes if Type is an xsimd register */
 template <typename Type>
-std::enable_if_t<std::is_floating_point_v<Type>, void>
-    clear(Type** channels, int startChannel, int endChannel, int startSample, int endSample) noexcept
+void peakAndSumOfSquares(const Type* source, size_t numSamples, NumericType<Type>& peak, NumericType<Type>& sumOfSquares) noexcept
+{
+    size_t i = 0;
+
+    if constexpr (std::is_floating_point_v<Type>)
     {
-        for (int ch = startChannel; ch < endChannel; ++ch)
-            juce::FloatVectorOperations::clear(channels[ch] + startSample, endSample, startSample);
+        using b_type = xsimd::batch<Type>;
+        const auto vecEnd = numSamples - numSamples % b_type::size;
+        b_type m(0), s(0);
+
+        for (; i < vecEnd; i += b_type::size)
+        {
+            const auto x = b_type::load_unaligned(source + i);
+            m = xsimd::max(m, xsimd::abs(x));
+            s = xsimd::fma(x, x, s);
+        }
+
+        peak = xsimd::reduce_max(m);
+        sumOfSquares = xsimd::reduce_add(s);
+
+        for (; i < numSamples; ++i)
+        {
+            peak = jmax(peak, std::abs(source[i]));
+            sumOfSquares += source[i] * source[i];
+        }
     }
+    else
+    {
+        Type m(0), s(0);
+        for (; i < numSamples; ++i)
+        {
+            m = xsimd::max(m, xsimd::abs(source[i]));
+            s = xsimd::fma(source[i], source[i], s);
+        }
 
+        peak = xsimd::reduce_max(m);
+        sumOfSquares = xsimd::reduce_add(s);
+    }
+}
+
+/* smallest & largest sample values & sum of squares in one pass, across all lanes if Type is an xsimd register */
 template <typename Type>
-std::enable_if_t<std::is_same_v<Type, xsimd::batch<double>>, void>
-    clear(Type** channels, int startChannel, int endChannel, int startSample, int endSample) noexcept
+void minMaxAndSumOfSquares(const Type* source, size_t numSamples, NumericType<Type>& min, NumericType<Type>& max, NumericType<Type>& sumOfSquares) noexcept
+{
+    using N = NumericType<Type>;
+    size_t i = 0;
+
+    if constexpr (std::is_floating_point_v<Type>)
     {
-        for (int ch = startChannel; ch < endChannel; ++ch)
-            std::fill(channels[ch] + startSample, channels[ch] + endSample, Type{});
+        using b_type = xsimd::batch<Type>;
+        const auto vecEnd = numSamples - numSamples % b_type::size;
+        b_type lo(std::numeric_limits<N>::max()), hi(std::numeric_limits<N>::lowest()), s(0);
+
+        for (; i < vecEnd; i += b_type::size)
+        {
+            const auto x = b_type::load_unaligned(source + i);
+            lo = xsimd::min(lo, x);
+            hi = xsimd::max(hi, x);
+            s = xsimd::fma(x, x, s);
+        }
+
+        min = xsimd::reduce_min(lo);
+        max = xsimd::reduce_max(hi);
+        sumOfSquares = xsimd::reduce_add(s);
+
+        for (; i < numSamples; ++i)
+        {
+            min = jmin(min, source[i]);
+            max = jmax(max, source[i]);
+            sumOfSquares += source[i] * source[i];
+        }
     }
+    else
+    {
+        Type lo(std::numeric_limits<N>::max()), hi(std::numeric_limits<N>::lowest()), s(0);
+        for (; i < numSamples; ++i)
+        {
+            lo = xsimd::min(lo, source[i]);
+            hi = xsimd::max(hi, source[i]);
+            s = xsimd::fma(source[i], source[i], s);
+        }
+
+        min = xsimd::reduce_min(lo);
+        max = xsimd::reduce_max(hi);
+        sumOfSquares = xsimd::reduce_add(s);
+    }
+}
+
+/**
+ * Element-wise copy with conversion.
+ * float <-> double converts each sample, float/double -> xsimd::batch broadcasts each
+ * sample across the register's lanes, and batch<float> <-> batch<double> converts lane-by-lane
+ * (the narrower register's lanes fill the first lanes of the wider one)
+ */
+template <typename DestType, typename SourceType>
+void copy(DestType* dest, const SourceType* source, size_t numSamples) noexcept
+{
+    if constexpr (std::is_same_v<DestType, SourceType>)
+    {
+        memcpy(dest, source, numSamples * sizeof(DestType));
+    }
+    else if constexpr (std::is_floating_point_v<DestType> && std::is_floating_point_v<SourceType>)
+    {
+        using b_type = xsimd::batch<DestType>;
+        const auto vecEnd = numSamples - numSamples % b_type::size;
+        size_t i = 0;
+
+        for (; i < vecEnd; i += b_type::size)
+            b_type::load_unaligned(source + i).store_unaligned(dest + i);
+
+        for (; i < numSamples; ++i)
+            dest[i] = static_cast<DestType>(source[i]);
+    }
+    else if constexpr (xsimd::is_batch<DestType>::value && std::is_floating_point_v<SourceType>)
+    {
+        for (size_t i = 0; i < numSamples; ++i)
+            dest[i] = DestType(static_cast<NumericType<DestType>>(source[i]));
+    }
+    else
+    {
+        static_assert(xsimd::is_batch<DestType>::value && xsimd::is_batch<SourceType>::value,
+                      "Can't convert an xsimd register to a single sample");
+
+        using DestNumeric = NumericType<DestType>;
+        using SourceNumeric = NumericType<SourceType>;
+
+        for (size_t i = 0; i < numSamples; ++i)
+        {
+            alignas(SourceType::arch_type::alignment()) SourceNumeric in[SourceType::size];
+            alignas(DestType::arch_type::alignment()) DestNumeric out[DestType::size]{};
+            source[i].store_aligned(in);
+
+            for (size_t lane = 0; lane < jmin(SourceType::size, DestType::size); ++lane)
+                out[lane] = static_cast<DestNumeric>(in[lane]);
+
+            dest[i] = DestType::load_aligned(out);
+        }
+    }
+}
+}
+
+/**
+ * Helpers for processors that want to skip work on silent input
+ */
+namespace silence
+{
+/* filter/delay state below this magnitude (~ -120dB) is treated as fully decayed */
+static constexpr double threshold = 1.0e-6;
+
+/* true if x (every lane of x, for xsimd registers) is below the threshold */
+template <typename T>
+bool isBelow(const T& x, double thresh = threshold) noexcept
+{
+    if constexpr (xsimd::is_batch<T>::value)
+        return xsimd::all(xsimd::abs(x) < T((typename T::value_type)thresh));
+    else
+        return std::abs(x) < (T)thresh;
+}
+}
+
+namespace buffer_clear
+{
+template <typename Type>
+void clear(Type** channels, int startChannel, int endChannel, int startSample, int endSample) noexcept
+{
+    for (int ch = startChannel; ch < endChannel; ++ch)
+        buffer_ops::clear(channels[ch] + startSample, (size_t)(endSample - startSample));
+}
 }
 
 /**
@@ -39,9 +384,19 @@ std::enable_if_t<std::is_same_v<Type, xsimd::batch<double>>, void>
     #define CHECK_BLOCK(a)
 #endif
 
-template <typename Type>
+/* Pass this as Buffer's MaxChannels to size the channel table at runtime (in reserve())
+instead of at compile time */
+static constexpr size_t dynamicChannelCount = 0;
+
+/**
+ * @tparam MaxChannels max number of channels the buffer can hold. Fixed channel counts keep
+ * the channel pointers in a std::array; dynamicChannelCount preallocates them in reserve()
+ */
+template <typename Type, size_t MaxChannels = 8>
 class Buffer
 {
+    static constexpr bool isDynamic = MaxChannels == dynamicChannelCount;
+
 public:
     Buffer() = default;
 
@@ -52,46 +407,97 @@ public:
     }
 
     /* Move constructor */
-    Buffer(Buffer<Type> &&) noexcept = default;
+    Buffer(Buffer &&) noexcept = default;
 
     /* Move assignment */
-    Buffer<Type> &operator=(Buffer<Type> &&) noexcept = default;
+    Buffer &operator=(Buffer &&) noexcept = default;
 
     int getNumChannels() const noexcept { return nChannels; }
     int getNumSamples() const noexcept { return nSamples; }
 
-    /* ALWAYS reallocates. Don't call this from the audio thread or anywhere you can't
-    tolerate locking */
-    void setSize(int newNumChannels, int newNumSamples)
+    /* Reserves one contiguous, SIMD-aligned block of memory big enough for
+    maxChannels x maxSamples, with each channel padded out to the alignment boundary.
+    This allocates, so call it from prepareToPlay() or similar. Any later call to setSize()
+    that fits within the reserved capacity won't allocate, so it's safe on the audio thread */
+    void reserve(int maxChannels, int maxSamples)
     {
-        jassert(isPositiveAndBelow(newNumChannels, 8));
-        jassert(newNumSamples > 0);
+        jassert(maxChannels > 0 && (isDynamic || maxChannels <= (int)MaxChannels));
+        jassert(maxSamples > 0);
+
+        channelStride = getPaddedLength((size_t)maxSamples);
+        arena.assign((size_t)maxChannels * channelStride, Type{});
+
+        if constexpr (isDynamic)
+        {
+            channelPointers.assign((size_t)maxChannels, nullptr);
+            silentRegions.assign((size_t)maxChannels, 0);
+        }
 
-        rawData.clear();
-        rawData.resize((size_t)newNumChannels, ChannelData((size_t)newNumSamples, Type{}));
+        for (int ch = 0; ch < maxChannels; ++ch)
+            channelPointers[ch] = arena.data() + (size_t)ch * channelStride;
+
+        channelCapacity = maxChannels;
+        sampleCapacity = (int)channelStride;
+
+        nChannels = jmin(nChannels, maxChannels);
+        nSamples = jmin(nSamples, maxSamples);
+        updateSilenceRegionSize();
         isCleared = true;
+        markAllSilent();
+    }
 
-        for (int ch = 0; ch < newNumChannels; ++ch)
-            channelPointers[ch] = rawData[ch].data();
+    /* Only reallocates if the new size exceeds what has been reserved, otherwise this
+    just updates the channel & sample counts and clears the active region. Call reserve()
+    ahead of time if you need this to be realtime-safe */
+    void setSize(int newNumChannels, int newNumSamples)
+    {
+        jassert(newNumChannels > 0 && (isDynamic || newNumChannels <= (int)MaxChannels));
+        jassert(newNumSamples > 0);
+
+        if (newNumChannels > channelCapacity || newNumSamples > sampleCapacity)
+            reserve(jmax(newNumChannels, channelCapacity), jmax(newNumSamples, sampleCapacity));
+        else
+            isCleared = false;
 
         nChannels = newNumChannels;
         nSamples = newNumSamples;
+        updateSilenceRegionSize();
+        clear();
     }
 
+    int getChannelCapacity() const noexcept { return channelCapacity; }
+    int getSampleCapacity() const noexcept { return sampleCapacity; }
+
     Type* getWritePointer(int channel) noexcept
     {
         isCleared = false;
+        silentRegions[channel] = 0;
         return channelPointers[channel];
     }
 
-    const Type* getReadPointer(int channel) noexcept
+    Type* getWritePointer(int channel, int sampleIndex) noexcept
+    {
+        jassert(isPositiveAndNotGreaterThan(sampleIndex, nSamples));
+        isCleared = false;
+        silentRegions[channel] = 0;
+        return channelPointers[channel] + sampleIndex;
+    }
+
+    const Type* getReadPointer(int channel) const noexcept
     {
         return channelPointers[channel];
     }
 
+    const Type* getReadPointer(int channel, int sampleIndex) const noexcept
+    {
+        jassert(isPositiveAndNotGreaterThan(sampleIndex, nSamples));
+        return channelPointers[channel] + sampleIndex;
+    }
+
     Type** getArrayOfWritePointers() noexcept
     {
         isCleared = false;
+        std::fill(silentRegions.begin(), silentRegions.end(), 0);
         return channelPointers.data();
     }
 
@@ -102,16 +508,35 @@ public:
 
     void clear() noexcept
     {
-        if (isCleared)
-            return;
+        if (!isCleared)
+            buffer_clear::clear<Type>(channelPointers.data(), 0, nChannels, 0, nSamples);
 
-        buffer_clear::clear<Type>(channelPointers.data(), 0, nChannels, 0, nSamples);
         isCleared = true;
+        markAllSilent();
     }
 
-    template <typename OtherType>
-    void makeCopyOf(const Buffer<OtherType>& other, bool avoidReallocating = false)
+    /* Clears a range of samples in one channel */
+    void clear(int channel, int startSample, int numSamples) noexcept
     {
+        jassert(isPositiveAndBelow(channel, nChannels));
+        jassert(startSample >= 0 && startSample + numSamples <= nSamples);
+
+        if (!isCleared && numSamples > 0)
+            buffer_ops::clear(channelPointers[channel] + startSample, (size_t)numSamples);
+
+        silentRegions[channel] |= getCoveredRegions(startSample, numSamples);
+    }
+
+    /* Copies another buffer's contents, converting the sample type if needed.
+    Only reallocates if the other buffer is bigger than this one's reserved capacity */
+    template <typename OtherType, size_t OtherMaxChannels>
+    void makeCopyOf(const Buffer<OtherType, OtherMaxChannels>& other, bool avoidReallocating = false)
+    {
+        jassert(!avoidReallocating || (other.nChannels <= channelCapacity && other.nSamples <= sampleCapacity));
+
+        if (other.nChannels != nChannels || other.nSamples != nSamples)
+            setSize(other.nChannels, other.nSamples);
+
         if (other.isCleared)
             clear();
         else
@@ -120,11 +545,8 @@ public:
 
             for (int ch = 0; ch < nChannels; ++ch)
             {
-                auto *dest = channelPointers[ch];
-                auto *src = other.getReadPointer(ch);
-
-                for (int i = 0; i < nSamples; ++i)
-                    dest[i] = static_cast<Type>(src[i]);
+                buffer_ops::copy(channelPointers[ch], other.getReadPointer(ch), (size_t)nSamples);
+                silentRegions[ch] = other.silentRegions[ch];
             }
         }
     }
@@ -137,62 +559,265 @@ public:
                 clear();
             else {
                 for (int ch = 0; ch < nChannels; ++ch)
-                    for (int i = 0; i < nSamples; ++i)
-                        channelPointers[ch][i] *= gain;
+                    buffer_ops::multiply(channelPointers[ch], (Numeric)gain, (size_t)nSamples);
             }
         }
     }
 
+    void applyGain(int channel, int startSample, int numSamples, double gain) noexcept
+    {
+        jassert(isPositiveAndBelow(channel, nChannels));
+        jassert(startSample >= 0 && startSample + numSamples <= nSamples);
+
+        if (gain != 1.0 && !isCleared)
+        {
+            if (gain == 0.0)
+                clear(channel, startSample, numSamples);
+            else
+                buffer_ops::multiply(channelPointers[channel] + startSample, (Numeric)gain, (size_t)numSamples);
+        }
+    }
+
+    /* Applies a gain that ramps linearly from startGain to endGain over the range */
+    void applyGainRamp(int channel, int startSample, int numSamples, double startGain, double endGain) noexcept
+    {
+        if (startGain == endGain)
+        {
+            applyGain(channel, startSample, numSamples, startGain);
+            return;
+        }
+
+        jassert(isPositiveAndBelow(channel, nChannels));
+        jassert(startSample >= 0 && startSample + numSamples <= nSamples);
+
+        if (!isCleared)
+            buffer_ops::gainRamp(channelPointers[channel] + startSample, (Numeric)startGain, (Numeric)endGain, (size_t)numSamples);
+    }
+
+    void applyGainRamp(int startSample, int numSamples, double startGain, double endGain) noexcept
+    {
+        for (int ch = 0; ch < nChannels; ++ch)
+            applyGainRamp(ch, startSample, numSamples, startGain, endGain);
+    }
+
     void copyFrom(int destChan, int startSample, const Type* source, int numSamples) noexcept
     {
         jassert(isPositiveAndBelow(destChan, nChannels));
-        jassert(numSamples < nSamples);
+        jassert(startSample >= 0 && startSample + numSamples <= nSamples);
         jassert(source != nullptr);
-        
+
         if (numSamples > 0)
         {
             isCleared = false;
-            memcpy(channelPointers[destChan], source, (size_t)numSamples * sizeof(Type));
+            silentRegions[destChan] &= ~getOverlappedRegions(startSample, numSamples);
+            memcpy(channelPointers[destChan] + startSample, source, (size_t)numSamples * sizeof(Type));
+        }
+    }
+
+    /* Copies a range from another buffer's channel, carrying its silence flags across
+    so a silent source region stays known-silent here */
+    template <size_t OtherMaxChannels>
+    void copyFrom(int destChan, int destStartSample, const Buffer<Type, OtherMaxChannels>& source,
+                  int sourceChan, int sourceStartSample, int numSamples) noexcept
+    {
+        jassert(isPositiveAndBelow(sourceChan, source.nChannels));
+        jassert(sourceStartSample >= 0 && sourceStartSample + numSamples <= source.nSamples);
+
+        if (source.isRegionSilent(sourceChan, sourceStartSample, numSamples))
+            clear(destChan, destStartSample, numSamples);
+        else
+            copyFrom(destChan, destStartSample, source.getReadPointer(sourceChan, sourceStartSample), numSamples);
+    }
+
+    void copyFrom(int destChan, int destStartSample, const Type* source, int numSamples, double gain) noexcept
+    {
+        jassert(isPositiveAndBelow(destChan, nChannels));
+        jassert(destStartSample >= 0 && destStartSample + numSamples <= nSamples);
+        jassert(source != nullptr);
+
+        if (numSamples <= 0)
+            return;
+
+        if (gain == 0.0)
+            clear(destChan, destStartSample, numSamples);
+        else
+        {
+            isCleared = false;
+            silentRegions[destChan] &= ~getOverlappedRegions(destStartSample, numSamples);
+            buffer_ops::copyWithGain(channelPointers[destChan] + destStartSample, source, (Numeric)gain, (size_t)numSamples);
         }
     }
 
     void addFrom(int destChan, int startSample, const Type* source, int numSamples, double gain = 1.0) noexcept
     {
+        jassert(isPositiveAndBelow(destChan, nChannels));
+        jassert(startSample >= 0 && startSample + numSamples <= nSamples);
+
         if (gain != 0.0 && numSamples > 0)
         {
+            auto* dest = channelPointers[destChan] + startSample;
+            silentRegions[destChan] &= ~getOverlappedRegions(startSample, numSamples);
+
             if (isCleared)
             {
                 isCleared = false;
                 if (gain != 1.0)
-                    for (int i = 0; i < numSamples; ++i)
-                        channelPointers[destChan][i] = source[i] * gain;
+                    buffer_ops::copyWithGain(dest, source, (Numeric)gain, (size_t)numSamples);
                 else
-                    memcpy(channelPointers[destChan], source, (size_t)numSamples * sizeof(Type));
+                    memcpy(dest, source, (size_t)numSamples * sizeof(Type));
             }
             else
-            {
-                if (gain != 1.0)
-                    for (int i = 0; i < numSamples; ++i)
-                        channelPointers[destChan][i] += source[i] * gain;
-                else
-                    for (int i = 0; i < numSamples; ++i)
-                        channelPointers[destChan][i] += source[i];
-            }
+                buffer_ops::addWithGain(dest, source, (Numeric)gain, (size_t)numSamples);
         }
     }
 
+    /* Multiplies a range of one channel by the samples in source */
+    void multiplyFrom(int destChan, int startSample, const Type* source, int numSamples) noexcept
+    {
+        jassert(isPositiveAndBelow(destChan, nChannels));
+        jassert(startSample >= 0 && startSample + numSamples <= nSamples);
+
+        if (!isCleared && numSamples > 0)
+            buffer_ops::multiply(channelPointers[destChan] + startSample, source, (size_t)numSamples);
+    }
+
+    //==============================================================================
+    /* Silence metadata. Each channel is split into up to maxSilenceRegions regions of
+    getSilenceRegionSize() samples, with one bit per region that's set while the region
+    is known to hold only zeroes. clear() & copyFrom() maintain these; handing out a
+    write pointer forgets whatever was known about that channel */
+
+    static constexpr int maxSilenceRegions = 64;
+
+    bool isSilent() const noexcept
+    {
+        if (isCleared)
+            return true;
+
+        for (int ch = 0; ch < nChannels; ++ch)
+            if (!isChannelSilent(ch))
+                return false;
+
+        return true;
+    }
+
+    bool isChannelSilent(int channel) const noexcept
+    {
+        return (silentRegions[channel] & getAllRegions()) == getAllRegions();
+    }
+
+    /* true if every region overlapping the range is known to be silent */
+    bool isRegionSilent(int channel, int startSample, int numSamples) const noexcept
+    {
+        const auto mask = getOverlappedRegions(startSample, numSamples);
+        return (silentRegions[channel] & mask) == mask;
+    }
+
+    uint64_t getSilentRegionMask(int channel) const noexcept { return silentRegions[channel]; }
+    int getSilenceRegionSize() const noexcept { return silenceRegionSize; }
+
+    /* Scans a channel and flags each region whose peak is at or below threshold as silent.
+    Use this on data written through raw pointers (e.g. straight from the host) */
+    void detectSilence(int channel, double threshold = 0.0) noexcept
+    {
+        jassert(isPositiveAndBelow(channel, nChannels));
+
+        uint64_t mask = 0;
+        for (int r = 0, start = 0; start < nSamples; ++r, start += silenceRegionSize)
+        {
+            const auto n = jmin(silenceRegionSize, nSamples - start);
+            if ((double)buffer_ops::maxAbs(channelPointers[channel] + start, (size_t)n) <= threshold)
+                mask |= (uint64_t)1 << r;
+        }
+
+        silentRegions[channel] = mask;
+    }
+
+    void detectSilence(double threshold = 0.0) noexcept
+    {
+        for (int ch = 0; ch < nChannels; ++ch)
+            detectSilence(ch, threshold);
+    }
+
 private:
     using Allocator = xsimd::default_allocator<Type>;
-    using ChannelData = std::vector<Type, Allocator>;
-    std::vector<ChannelData> rawData;
+    using Numeric = buffer_ops::NumericType<Type>;
+
+    /* number of elements that make up one SIMD alignment boundary */
+    static constexpr size_t alignmentElements = jmax((size_t)1, xsimd::default_arch::alignment() / sizeof(Type));
+
+    static constexpr size_t getPaddedLength(size_t numSamples) noexcept
+    {
+        return ((numSamples + alignmentElements - 1) / alignmentElements) * alignmentElements;
+    }
+
+    /* all channels live in this one block, channelStride elements apart */
+    std::vector<Type, Allocator> arena;
+    size_t channelStride = 0;
 
     int nChannels = 0, nSamples = 0;
+    int channelCapacity = 0, sampleCapacity = 0;
     bool isCleared = false;
 
-    size_t allocatedBytes = 0;
+    using SilenceTable = std::conditional_t<isDynamic, std::vector<uint64_t>, std::array<uint64_t, MaxChannels>>;
+    SilenceTable silentRegions{};
+    int silenceRegionSize = 1;
+
+    void updateSilenceRegionSize() noexcept
+    {
+        silenceRegionSize = jmax(1, (nSamples + maxSilenceRegions - 1) / maxSilenceRegions);
+    }
+
+    static constexpr uint64_t getRegionBits(int first, int last) noexcept
+    {
+        if (last < first)
+            return 0;
+
+        const auto count = last - first + 1;
+        return (count >= 64 ? ~(uint64_t)0 : (((uint64_t)1 << count) - 1)) << first;
+    }
+
+    uint64_t getAllRegions() const noexcept
+    {
+        return getRegionBits(0, (nSamples + silenceRegionSize - 1) / silenceRegionSize - 1);
+    }
+
+    /* regions that share at least one sample with the range */
+    uint64_t getOverlappedRegions(int startSample, int numSamples) const noexcept
+    {
+        if (numSamples <= 0)
+            return 0;
+
+        return getRegionBits(startSample / silenceRegionSize, (startSample + numSamples - 1) / silenceRegionSize);
+    }
+
+    /* regions that lie entirely inside the range */
+    uint64_t getCoveredRegions(int startSample, int numSamples) const noexcept
+    {
+        if (numSamples <= 0)
+            return 0;
+
+        const auto end = startSample + numSamples;
+        const auto first = (startSample + silenceRegionSize - 1) / silenceRegionSize;
+        const auto last = (end >= nSamples ? (nSamples + silenceRegionSize - 1) : end) / silenceRegionSize - 1;
+        return getRegionBits(first, last);
+    }
 
-    /* using max of 8 channels for now */
-    std::array<Type*, (size_t)8> channelPointers{};
+    void markAllSilent() noexcept
+    {
+        for (int ch = 0; ch < nChannels; ++ch)
+            silentRegions[ch] = getAllRegions();
+    }
+
+    using ChannelTable = std::conditional_t<isDynamic, std::vector<Type*>, std::array<Type*, MaxChannels>>;
+    ChannelTable channelPointers{};
+
+    template <typename, size_t>
+    friend class Buffer;
 
     JUCE_LEAK_DETECTOR (Buffer)
-};
\ No newline at end of file
+};
+
+/* Buffer whose channel count is only bounded by what's passed to reserve() */
+template <typename Type>
+using DynamicBuffer = Buffer<Type, dynamicChannelCount>;
\ No newline at end of file
@@ -4,6 +4,9 @@
 template <typename SampleType>
 class Delay
 {
+    using NumericType = buffer_ops::NumericType<SampleType>;
+    static constexpr size_t numLanes = sizeof(SampleType) / sizeof(NumericType);
+
 public:
     //==============================================================================
     /** Default constructor. */
@@ -28,21 +31,37 @@ public:
         auto upperLimit = (double)getMaximumDelayInSamples();
         jassert(isPositiveAndNotGreaterThan(newDelayInSamples, upperLimit));
 
-        delay = jlimit((double)0, upperLimit, newDelayInSamples);
-        delayInt = static_cast<int>(std::floor(delay));
-        delayFrac = delay - (double)delayInt;
+        const auto newDelay = jlimit((double)0, upperLimit, newDelayInSamples);
+        const auto wholeSamples = static_cast<int>(std::floor(newDelay));
+
+        delay = static_cast<SampleType>(static_cast<NumericType>(newDelay));
+        delayFrac = static_cast<SampleType>(static_cast<NumericType>(newDelay - (double)wholeSamples));
+        std::fill(delayInt.begin(), delayInt.end(), wholeSamples);
+        uniformDelay = true;
 
         // updateInternalVariables();
     }
 
-    void setDelay(xsimd::batch<double> newDelayInSamples)
+    /** Sets a separate delay for every lane of an xsimd register, e.g. one delay per
+        channel of an interleaved block. Only available when SampleType is a register. */
+    template <typename T = SampleType, std::enable_if_t<xsimd::is_batch<T>::value, int> = 0>
+    void setDelay(T newDelayInSamples)
     {
-        auto upperLimit = (SampleType)getMaximumDelayInSamples();
-        jassert(isPositiveAndNotGreaterThan(newDelayInSamples, upperLimit));
+        const auto upperLimit = static_cast<NumericType>(getMaximumDelayInSamples());
+        jassert(xsimd::all(newDelayInSamples >= T((NumericType)0) && newDelayInSamples <= T(upperLimit)));
+
+        delay = xsimd::max(T((NumericType)0), xsimd::min(newDelayInSamples, T(upperLimit)));
+
+        const auto wholeSamples = xsimd::floor(delay);
+        delayFrac = delay - wholeSamples;
+
+        alignas(T::arch_type::alignment()) NumericType lanes[numLanes];
+        wholeSamples.store_aligned(lanes);
 
-        delay = xsimd::max((SampleType)0.0, xsimd::min(newDelayInSamples, upperLimit));
-        delayInt = static_cast<int>(std::floor(delay));
-        delayFrac = delay - (SampleType)delayInt;
+        for (size_t i = 0; i < numLanes; ++i)
+            delayInt[i] = static_cast<int>(lanes[i]);
+
+        uniformDelay = std::all_of(delayInt.begin(), delayInt.end(), [&](int d) { return d == delayInt[0]; });
     }
 
     /** Returns the current delay in samples. */
@@ -100,7 +119,9 @@ public:
             std::fill(vec->begin(), vec->end(), 0);
 
         for (auto &buf : bufferData)
-            std::fill(buf.begin(), buf.end(), 0.0);
+            std::fill(buf.begin(), buf.end(), static_cast<SampleType>(0));
+
+        silentSamplesPushed = totalSize;
     }
 
     //==============================================================================
@@ -114,9 +135,8 @@ public:
     */
     void pushSample(int channel, SampleType sample)
     {
-        // bufferData.setSample (channel, writePos[(size_t) channel], sample);
-        bufferData[channel][writePos[channel]] = sample;
-        writePos[(size_t)channel] = (writePos[(size_t)channel] + totalSize - 1) % totalSize;
+        silentSamplesPushed = 0;
+        writeSample(channel, sample);
     }
 
     /** Pops a single sample from one channel of the delay line.
@@ -172,6 +192,36 @@ public:
     */
     template <class Block>
     void processBlock(Block &block) noexcept
+    {
+        silentSamplesPushed = 0;
+        processInternal(block);
+    }
+
+    /** Processes a block which may be known to be silent.
+
+        Once enough silent input has been pushed to flush the whole line, further
+        silent blocks are left untouched and the delay line is skipped entirely.
+    */
+    template <class Block>
+    void processBlock(Block &block, bool inputIsSilent) noexcept
+    {
+        if (!inputIsSilent)
+        {
+            processBlock(block);
+            return;
+        }
+
+        if (silentSamplesPushed >= totalSize)
+            return;
+
+        processInternal(block);
+        silentSamplesPushed = jmin(totalSize, silentSamplesPushed + (int)block.getNumSamples());
+    }
+
+private:
+    //==============================================================================
+    template <class Block>
+    void processInternal(Block &block) noexcept
     {
         const auto numChannels = block.getNumChannels();
         const auto numSamples = block.getNumSamples();
@@ -186,18 +236,28 @@ public:
 
             for (size_t i = 0; i < numSamples; ++i)
             {
-                pushSample((int)channel, in[i]);
+                writeSample((int)channel, in[i]);
                 in[i] = popSample((int)channel);
             }
         }
     }
 
-private:
-    //==============================================================================
+    void writeSample(int channel, SampleType sample)
+    {
+        // bufferData.setSample (channel, writePos[(size_t) channel], sample);
+        bufferData[channel][writePos[channel]] = sample;
+        writePos[(size_t)channel] = (writePos[(size_t)channel] + totalSize - 1) % totalSize;
+    }
 
     SampleType interpolateSample(int channel) const
     {
-        auto index1 = readPos[(size_t)channel] + delayInt;
+        if constexpr (numLanes > 1)
+        {
+            if (!uniformDelay)
+                return interpolateLanes(channel);
+        }
+
+        auto index1 = readPos[(size_t)channel] + delayInt[0];
         auto index2 = index1 + 1;
 
         if (index2 >= totalSize)
@@ -214,6 +274,27 @@ private:
         return value1 + delayFrac * (value2 - value1);
     }
 
+    // each lane has its own read position, so gather both taps lane by lane
+    SampleType interpolateLanes(int channel) const
+    {
+        alignas(SampleType::arch_type::alignment()) NumericType value1[numLanes], value2[numLanes];
+        const auto &line = bufferData[channel];
+
+        for (size_t i = 0; i < numLanes; ++i)
+        {
+            const auto index1 = (readPos[(size_t)channel] + delayInt[i]) % totalSize;
+            const auto index2 = (index1 + 1) % totalSize;
+
+            value1[i] = reinterpret_cast<const NumericType *>(&line[index1])[i];
+            value2[i] = reinterpret_cast<const NumericType *>(&line[index2])[i];
+        }
+
+        const auto v1 = SampleType::load_aligned(value1);
+        const auto v2 = SampleType::load_aligned(value2);
+
+        return v1 + delayFrac * (v2 - v1);
+    }
+
     //==============================================================================
     double sampleRate = 44100.0;
 
@@ -221,7 +302,10 @@ private:
     // AudioBuffer<SampleType> bufferData;
     std::vector<std::vector<SampleType>> bufferData;
     std::vector<int> writePos, readPos;
-    double delay = 0.0, delayFrac = 0.0;
-    int delayInt = 0, totalSize = 4;
+    SampleType delay = static_cast<SampleType>(0), delayFrac = static_cast<SampleType>(0);
+    std::array<int, numLanes> delayInt{}; // integer part of the delay, per lane
+    bool uniformDelay = true;             // every lane reads from the same position
+    int totalSize = 4;
+    int silentSamplesPushed = 0; // number of zeroes pushed since the last non-silent block
     SampleType alpha = 0.0;
 };
\ No newline at end of file
@@ -0,0 +1,200 @@
+/**
+ * Dispatch.h
+ * Runtime CPU dispatch for flat-array kernels (gain, mix, fast_tanh...)
+ *
+ * Each kernel is written once against xsimd::batch<T, Arch>. By default only the arch the
+ * build targets is compiled, so nothing changes. Define STRIX_RUNTIME_DISPATCH=1 and link
+ * the per-ISA translation units in modules/dispatch (the arbor_dispatch target in
+ * CMakeLists.txt builds them with the right flags) and the widest of SSE2/AVX2/AVX-512 that
+ * the CPU supports gets picked the first time getKernels() is called.
+ *
+ * Only flat float/double arrays are dispatched. Interleaved `vec` processing keeps the
+ * register width of the build, since the batch type is part of those processors' types.
+ *
+ * Doesn't depend on JUCE, so the per-ISA translation units can include it on their own.
+ *
+ * Those translation units are compiled with -mavx2/-mavx512f, so every inline function they
+ * instantiate gets that encoding. Anything whose mangled name doesn't carry the Arch (a
+ * scalar fast_tanh<float>, std::copy, a helper that isn't a template...) would be merged by
+ * the linker with the baseline copy the rest of the plugin uses, and might crash with SIGILL
+ * on older CPUs. So kernels only call code templated on Arch, i.e. batch<T, Arch> overloads,
+ * and do their scalar work with plain loops & operators inside Kernels<Arch, T> itself.
+ * Check new kernels against this, e.g. with `nm -C` on the arbor_dispatch objects: every
+ * weak symbol should mention the arch.
+ */
+
+#pragma once
+
+#ifndef STRIX_RUNTIME_DISPATCH
+ #define STRIX_RUNTIME_DISPATCH 0
+#endif
+
+namespace dispatch
+{
+template <typename T>
+struct KernelTable
+{
+    void (*multiply) (T* dest, T gain, size_t numSamples) noexcept;
+    void (*gainRamp) (T* dest, T startGain, T endGain, size_t numSamples) noexcept;
+    void (*addWithGain) (T* dest, const T* source, T gain, size_t numSamples) noexcept;
+    void (*multiplyBy) (T* dest, const T* source, size_t numSamples) noexcept;
+    void (*fastTanh) (T* data, size_t numSamples) noexcept;
+    const char* archName;
+};
+
+/* Member functions are defined out of line so that the `extern template` declarations
+below really do keep other ISAs from being instantiated in this translation unit */
+template <class Arch, typename T>
+struct Kernels
+{
+    using b_type = xsimd::batch<T, Arch>;
+
+    static void multiply (T* dest, T gain, size_t numSamples) noexcept;
+    static void gainRamp (T* dest, T startGain, T endGain, size_t numSamples) noexcept;
+    static void addWithGain (T* dest, const T* source, T gain, size_t numSamples) noexcept;
+    static void multiplyBy (T* dest, const T* source, size_t numSamples) noexcept;
+    static void fastTanh (T* data, size_t numSamples) noexcept;
+};
+
+template <class Arch, typename T>
+void Kernels<Arch, T>::multiply (T* dest, T gain, size_t numSamples) noexcept
+{
+    const auto vecEnd = numSamples - numSamples % b_type::size;
+    const b_type g (gain);
+    size_t i = 0;
+
+    for (; i < vecEnd; i += b_type::size)
+        (b_type::load_unaligned (dest + i) * g).store_unaligned (dest + i);
+
+    for (; i < numSamples; ++i)
+        dest[i] *= gain;
+}
+
+template <class Arch, typename T>
+void Kernels<Arch, T>::gainRamp (T* dest, T startGain, T endGain, size_t numSamples) noexcept
+{
+    if (numSamples == 0)
+        return;
+
+    const auto inc = (endGain - startGain) / (T) numSamples;
+    const auto vecEnd = numSamples - numSamples % b_type::size;
+    size_t i = 0;
+
+    alignas (Arch::alignment()) T offsets[b_type::size];
+    for (size_t j = 0; j < b_type::size; ++j)
+        offsets[j] = (T) j;
+
+    const b_type step (inc * (T) b_type::size);
+    auto g = b_type (startGain) + b_type::load_aligned (offsets) * b_type (inc);
+
+    for (; i < vecEnd; i += b_type::size)
+    {
+        (b_type::load_unaligned (dest + i) * g).store_unaligned (dest + i);
+        g += step;
+    }
+
+    for (; i < numSamples; ++i)
+        dest[i] *= startGain + inc * (T) i;
+}
+
+template <class Arch, typename T>
+void Kernels<Arch, T>::addWithGain (T* dest, const T* source, T gain, size_t numSamples) noexcept
+{
+    const auto vecEnd = numSamples - numSamples % b_type::size;
+    const b_type g (gain);
+    size_t i = 0;
+
+    for (; i < vecEnd; i += b_type::size)
+        xsimd::fma (b_type::load_unaligned (source + i), g, b_type::load_unaligned (dest + i)).store_unaligned (dest + i);
+
+    for (; i < numSamples; ++i)
+        dest[i] += source[i] * gain;
+}
+
+template <class Arch, typename T>
+void Kernels<Arch, T>::multiplyBy (T* dest, const T* source, size_t numSamples) noexcept
+{
+    const auto vecEnd = numSamples - numSamples % b_type::size;
+    size_t i = 0;
+
+    for (; i < vecEnd; i += b_type::size)
+        (b_type::load_unaligned (dest + i) * b_type::load_unaligned (source + i)).store_unaligned (dest + i);
+
+    for (; i < numSamples; ++i)
+        dest[i] *= source[i];
+}
+
+template <class Arch, typename T>
+void Kernels<Arch, T>::fastTanh (T* data, size_t numSamples) noexcept
+{
+    const auto vecEnd = numSamples - numSamples % b_type::size;
+    size_t i = 0;
+
+    for (; i < vecEnd; i += b_type::size)
+        fast_tanh (b_type::load_unaligned (data + i)).store_unaligned (data + i);
+
+    // The tail goes through a zero-padded register as well. Calling fast_tanh<T> here would
+    // emit a scalar copy of it built with this TU's ISA flags, under the same name as the
+    // plugin's baseline copy, and the linker is free to keep either one
+    if (i < numSamples)
+    {
+        alignas (Arch::alignment()) T tail[b_type::size] {};
+        for (size_t j = 0; i + j < numSamples; ++j)
+            tail[j] = data[i + j];
+
+        fast_tanh (b_type::load_aligned (tail)).store_aligned (tail);
+
+        for (size_t j = 0; i + j < numSamples; ++j)
+            data[i + j] = tail[j];
+    }
+}
+
+template <class Arch, typename T>
+KernelTable<T> makeKernelTable() noexcept
+{
+    using K = Kernels<Arch, T>;
+    return { &K::multiply, &K::gainRamp, &K::addWithGain, &K::multiplyBy, &K::fastTanh, Arch::name() };
+}
+
+#if STRIX_RUNTIME_DISPATCH && XSIMD_WITH_SSE2
+ #define STRIX_DISPATCH_DECLARE(Arch) \
+    extern template struct Kernels<Arch, float>; \
+    extern template struct Kernels<Arch, double>;
+
+STRIX_DISPATCH_DECLARE (xsimd::sse2)
+STRIX_DISPATCH_DECLARE (xsimd::avx2)
+STRIX_DISPATCH_DECLARE (xsimd::avx512f)
+
+ #undef STRIX_DISPATCH_DECLARE
+#endif
+
+/* Kernels for the widest instruction set available, chosen once on first use */
+template <typename T>
+const KernelTable<T>& getKernels() noexcept
+{
+    static const KernelTable<T> table = []
+    {
+       #if STRIX_RUNTIME_DISPATCH && XSIMD_WITH_SSE2
+        const auto available = xsimd::available_architectures();
+
+        if (available.avx512f)
+            return makeKernelTable<xsimd::avx512f, T>();
+        if (available.avx2)
+            return makeKernelTable<xsimd::avx2, T>();
+
+        return makeKernelTable<xsimd::sse2, T>();
+       #else
+        return makeKernelTable<xsimd::default_arch, T>();
+       #endif
+    }();
+
+    return table;
+}
+
+/* Call from somewhere early (e.g. a plugin's constructor) to get the CPU check out of the way */
+inline void init() noexcept
+{
+    getKernels<float>();
+    getKernels<double>();
+}
+}
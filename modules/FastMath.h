@@ -8,46 +8,313 @@ template <typename T>
 inline T fast_tanh(T x)
 {
     T x2 = x * x;
-    T a = x * (135135.0 + x2 * (17325.0 + x2 * (378.0 + x2)));
-    T b = 135135.0 + x2 * (62370.0 + x2 * (3150.0 + x2 * 28.0));
+    T a = x * (T(135135.0) + x2 * (T(17325.0) + x2 * (T(378.0) + x2)));
+    T b = T(135135.0) + x2 * (T(62370.0) + x2 * (T(3150.0) + x2 * T(28.0)));
     return a / b;
 }
 
+/* std:: for scalars & xsimd:: for registers, picked per call by type, so scalar and SIMD
+code can live in the same translation unit */
 template <typename T>
-#if USE_SIMD
 inline T tanh(T x)
 {
-    return xsimd::tanh(x);
+    if constexpr (xsimd::is_batch<T>::value)
+        return xsimd::tanh(x);
+    else
+        return std::tanh(x);
 }
-#else
-inline T tanh(T x)
+
+template <typename T>
+inline T atan(T x)
 {
-    return std::tanh(x);
+    if constexpr (xsimd::is_batch<T>::value)
+        return xsimd::atan(x);
+    else
+        return std::atan(x);
 }
-#endif
 
 template <typename T>
-#if USE_SIMD
-inline T atan(T x)
+inline T abs(T x)
 {
-    return xsimd::atan(x);
+    if constexpr (xsimd::is_batch<T>::value)
+        return xsimd::abs(x);
+    else
+        return std::abs(x);
 }
-#else
-inline T atan(T x)
+
+/** Accuracy tiers for the fast_ approximations below. Each function documents the
+    maximum error measured over its valid range, in double precision. In single
+    precision, medium & high are both limited by float rounding instead (~1e-7 relative).
+*/
+enum class MathAccuracy
+{
+    low,    // ~1e-5
+    medium, // ~1e-8
+    high    // ~1e-11
+};
+
+namespace fast_math
+{
+template <typename T, typename = void>
+struct Scalar { using type = T; };
+
+template <typename T>
+struct Scalar<T, std::enable_if_t<xsimd::is_batch<T>::value>> { using type = typename T::value_type; };
+
+template <typename T>
+using ScalarType = typename Scalar<T>::type;
+
+/* Near-minimax polynomial coefficients (fitted with Lawson's algorithm), lowest order first:
+    exp:  e^r                 for |r| <= ln(2)/2, relative error
+    log:  log((1+s)/(1-s))/s  in s^2, for |s| <= 0.1716, i.e. mantissas in [sqrt(1/2), sqrt(2))
+    sin:  sin(r)/r            in r^2, for |r| <= pi/4, relative error
+    cos:  cos(r)              in r^2, for |r| <= pi/4
+*/
+template <MathAccuracy>
+struct Coeffs;
+
+template <>
+struct Coeffs<MathAccuracy::low>
+{
+    static constexpr double exp[] = { 0.99992807355671776, 1.0001641862552044, 0.50496326388708757, 0.16566841791105164 };
+    static constexpr double log[] = { 1.9998879799921152, 0.68173889473549154 };
+    static constexpr double sin[] = { 0.99999857041599927, -0.16662480818938577, 0.0081516440292796234 };
+    static constexpr double cos[] = { 0.99999004193845298, -0.49970818571724845, 0.040398594846968318 };
+};
+
+template <>
+struct Coeffs<MathAccuracy::medium>
+{
+    static constexpr double exp[] = { 1.0000000716508597, 0.99999969182172943, 0.49998894876993, 0.16667575305927709,
+                                      0.041915379836810526, 0.0082976162442733037 };
+    static constexpr double log[] = { 2.0000008378061396, 0.66644063911454687, 0.41518189271900763 };
+    static constexpr double sin[] = { 0.99999999692854746, -0.16666650701973409, 0.0083320369636162035, -0.00019504030119039755 };
+    static constexpr double cos[] = { 0.99999997244382333, -0.49999856722309105, 0.041655027739911699, -0.0013585916423405659 };
+};
+
+template <>
+struct Coeffs<MathAccuracy::high>
+{
+    static constexpr double exp[] = { 0.99999999996168609, 1.0000000002431566, 0.50000001045273268, 0.16666665125908453,
+                                      0.041666225448834276, 0.0083335611211658289, 0.001394818191783149, 0.00019775157766833526 };
+    static constexpr double log[] = { 1.9999999937361295, 0.66666948716683938, 0.39965773087781786, 0.30100824304795626 };
+    static constexpr double sin[] = { 0.99999999999567446, -0.16666666631603708, 0.0083333287838934407, -0.00019839202629820223,
+                                      2.7173492239849047e-06 };
+    static constexpr double cos[] = { 0.99999999995265354, -0.49999999615538321, 0.04166661674496077, -0.0013886619327504938,
+                                      2.4379937369136858e-05 };
+};
+
+template <typename T>
+inline T constant(double value) noexcept { return T(static_cast<ScalarType<T>>(value)); }
+
+template <typename T, size_t N>
+inline T horner(T x, const double (&c)[N]) noexcept
 {
-    return std::atan(x);
+    auto y = constant<T>(c[N - 1]);
+    for (size_t i = N - 1; i-- > 0;)
+        y = y * x + constant<T>(c[i]);
+    return y;
+}
+
+template <typename T, typename Cond>
+inline T select(const Cond &cond, const T &a, const T &b) noexcept
+{
+    if constexpr (xsimd::is_batch<T>::value)
+        return xsimd::select(cond, a, b);
+    else
+        return cond ? a : b;
 }
-#endif
 
 template <typename T>
-#if USE_SIMD
-inline T abs(T x)
+inline T round(T x) noexcept
 {
-    return xsimd::abs(x);
+    if constexpr (xsimd::is_batch<T>::value)
+        return xsimd::nearbyint(x);
+    else
+        return std::nearbyint(x);
 }
-#else
-inline T abs(T x)
+
+template <typename T>
+inline T floor(T x) noexcept
+{
+    if constexpr (xsimd::is_batch<T>::value)
+        return xsimd::floor(x);
+    else
+        return std::floor(x);
+}
+
+template <typename T>
+inline T max(T a, T b) noexcept
+{
+    if constexpr (xsimd::is_batch<T>::value)
+        return xsimd::max(a, b);
+    else
+        return std::max(a, b);
+}
+
+template <typename T>
+inline T clamp(T x, T lo, T hi) noexcept
+{
+    if constexpr (xsimd::is_batch<T>::value)
+        return xsimd::max(lo, xsimd::min(x, hi));
+    else
+        return std::max(lo, std::min(x, hi));
+}
+
+/* x * 2^n, where n holds whole numbers */
+template <typename T>
+inline T ldexp(T x, T n) noexcept
+{
+    if constexpr (xsimd::is_batch<T>::value)
+        return xsimd::ldexp(x, xsimd::to_int(n));
+    else
+        return std::ldexp(x, static_cast<int>(n));
+}
+
+/* splits x into m * 2^e with m in [0.5, 1) */
+template <typename T>
+inline T frexp(T x, T &e) noexcept
+{
+    if constexpr (xsimd::is_batch<T>::value)
+    {
+        xsimd::batch<xsimd::as_integer_t<ScalarType<T>>, typename T::arch_type> exponent;
+        const auto m = xsimd::frexp(x, exponent);
+        e = xsimd::to_float(exponent);
+        return m;
+    }
+    else
+    {
+        int exponent;
+        const auto m = std::frexp(x, &exponent);
+        e = static_cast<T>(exponent);
+        return m;
+    }
+}
+
+template <typename T>
+inline auto isOdd(T wholeNumber) noexcept
+{
+    return wholeNumber - T(2) * floor(wholeNumber * T(0.5)) > T(0.5);
+}
+
+/* x = q * pi/2 + r with |r| <= pi/4, subtracting pi/2 in two parts (Cody & Waite) so r
+stays accurate for |x| up to ~1e4 */
+template <typename T>
+inline T reduceQuadrant(T x, T &q) noexcept
+{
+    q = round(x * constant<T>(0.63661977236758134));
+    return (x - q * constant<T>(1.5703125)) - q * constant<T>(4.8382679489661923e-4);
+}
+
+/* sin & cos of what's left of x after reduceQuadrant(), and which quadrant (0-3) x was in */
+template <MathAccuracy A, typename T>
+inline void sinCosQuadrant(T x, T &s, T &c, T &quadrant) noexcept
+{
+    T q;
+    const auto r = reduceQuadrant(x, q);
+    const auto r2 = r * r;
+
+    s = r * horner(r2, Coeffs<A>::sin);
+    c = horner(r2, Coeffs<A>::cos);
+    quadrant = q - T(4) * floor(q * T(0.25));
+}
+}
+
+/** e^x, with relative error below 7.5e-5 (low), 7.5e-8 (medium) or 4.1e-11 (high).
+    x is clamped to the range that doesn't overflow/underflow, +/-88 for float & +/-708 for double.
+*/
+template <MathAccuracy A = MathAccuracy::medium, typename T>
+inline T fast_exp(T x) noexcept
+{
+    constexpr double maxArg = std::is_same_v<fast_math::ScalarType<T>, float> ? 87.0 : 708.0;
+
+    x = fast_math::clamp(x, fast_math::constant<T>(-maxArg), fast_math::constant<T>(maxArg));
+    const auto n = fast_math::round(x * fast_math::constant<T>(1.4426950408889634));
+    const auto r = (x - n * fast_math::constant<T>(0.693145751953125)) - n * fast_math::constant<T>(1.4286068203094173e-6);
+
+    return fast_math::ldexp(fast_math::horner(r, fast_math::Coeffs<A>::exp), n);
+}
+
+/** Natural log of x > 0, with absolute error below 3.9e-6 (low), 2.1e-8 (medium) or
+    1.2e-10 (high). In float, rounding of the exponent term adds ~1 ulp of the result.
+    Zero & negative inputs give garbage rather than -inf/NaN.
+*/
+template <MathAccuracy A = MathAccuracy::medium, typename T>
+inline T fast_log(T x) noexcept
+{
+    T e;
+    auto m = fast_math::frexp(x, e);
+    const auto belowRoot2 = m < fast_math::constant<T>(0.70710678118654752);
+    m = fast_math::select(belowRoot2, m + m, m);
+    e = fast_math::select(belowRoot2, e - fast_math::constant<T>(1.0), e);
+
+    const auto s = (m - fast_math::constant<T>(1.0)) / (m + fast_math::constant<T>(1.0));
+    return e * fast_math::constant<T>(0.69314718055994531) + s * fast_math::horner(s * s, fast_math::Coeffs<A>::log);
+}
+
+/** sin(x), with absolute error below 1e-5 (low), 2.8e-8 (medium) or 4.7e-11 (high)
+    for |x| up to ~1e4, where the argument reduction starts to lose precision.
+*/
+template <MathAccuracy A = MathAccuracy::medium, typename T>
+inline T fast_sin(T x) noexcept
+{
+    T s, c, quadrant;
+    fast_math::sinCosQuadrant<A>(x, s, c, quadrant);
+
+    const auto y = fast_math::select(fast_math::isOdd(quadrant), c, s);
+    return fast_math::select(quadrant > T(1.5), -y, y);
+}
+
+/** cos(x), with absolute error below 1e-5 (low), 2.8e-8 (medium) or 4.7e-11 (high)
+    for |x| up to ~1e4.
+*/
+template <MathAccuracy A = MathAccuracy::medium, typename T>
+inline T fast_cos(T x) noexcept
+{
+    T s, c, quadrant;
+    fast_math::sinCosQuadrant<A>(x, s, c, quadrant);
+
+    const auto y = fast_math::select(fast_math::isOdd(quadrant), s, c);
+    return fast_math::select((quadrant > T(0.5)) & (quadrant < T(2.5)), -y, y);
+}
+
+/** tan(x), with relative error below 1.3e-5 (low), 3.6e-8 (medium) or 6.2e-11 (high) away
+    from the poles, for |x| up to ~1e4. Built for prewarping, tan(pi * fc / fs).
+*/
+template <MathAccuracy A = MathAccuracy::medium, typename T>
+inline T fast_tan(T x) noexcept
+{
+    T s, c, quadrant;
+    fast_math::sinCosQuadrant<A>(x, s, c, quadrant);
+
+    return fast_math::select(fast_math::isOdd(quadrant), -c / s, s / c);
+}
+
+/** cosh(x) from fast_exp, with the same relative error */
+template <MathAccuracy A = MathAccuracy::medium, typename T>
+inline T fast_cosh(T x) noexcept
+{
+    const auto e = fast_exp<A>(x);
+    return fast_math::constant<T>(0.5) * (e + fast_math::constant<T>(1.0) / e);
+}
+
+/** Decibels to gain, with fast_exp's relative error. Anything at or below
+    minusInfinityDb gives 0, like juce::Decibels::decibelsToGain()
+*/
+template <MathAccuracy A = MathAccuracy::medium, typename T>
+inline T fast_db_to_gain(T dB, fast_math::ScalarType<T> minusInfinityDb = -100) noexcept
+{
+    return fast_math::select(dB > T(minusInfinityDb), fast_exp<A>(dB * fast_math::constant<T>(0.11512925464970229)), T(0));
+}
+
+/** Gain to decibels, with error below 20 / ln(10) times fast_log's, i.e. 3.4e-5 dB (low),
+    1.8e-7 dB (medium) or 1e-9 dB (high). Floored at minusInfinityDb, like
+    juce::Decibels::gainToDecibels()
+*/
+template <MathAccuracy A = MathAccuracy::medium, typename T>
+inline T fast_gain_to_db(T gain, fast_math::ScalarType<T> minusInfinityDb = -100) noexcept
 {
-    return std::abs(x);
+    const auto floorDb = T(minusInfinityDb);
+    const auto dB = fast_log<A>(gain) * fast_math::constant<T>(8.6858896380650366);
+    return fast_math::select(gain > T(0), fast_math::max(dB, floorDb), floorDb);
 }
-#endif
\ No newline at end of file
@@ -9,9 +9,11 @@
 #include <math.h>
 #include <cmath>
 #include <vector>
+#include <algorithm>
+#include <type_traits>
 
 // moved this from SVTFilter.h
-// certain types will not be implemented yet
+// not every type here is implemented by every filter, see each one's coefficient code
 enum FilterType
 {
     lowpass,
@@ -23,9 +25,381 @@ enum FilterType
     firstOrderHighpass,
     firstOrderLowshelf,
     firstOrderHighshelf,
-    allpass
+    allpass,
+    lowshelf,
+    highshelf
 };
 
+/* Coefficient calculation for Filter, split out so it can run on any scalar or xsimd register
+type (e.g. several filters at once), and with either precise or fast transcendentals */
+namespace matched_filter
+{
+template <typename V>
+struct Coeffs
+{
+	V b0, b1, b2, a1, a2;
+};
+
+/* std:: & xsimd:: functions, what setCoeffs() uses */
+struct Precise
+{
+	template <typename V>
+	static V exp(V x)
+	{
+		if constexpr (xsimd::is_batch<V>::value)
+			return xsimd::exp(x);
+		else
+			return std::exp(x);
+	}
+
+	template <typename V>
+	static V cos(V x)
+	{
+		if constexpr (xsimd::is_batch<V>::value)
+			return xsimd::cos(x);
+		else
+			return std::cos(x);
+	}
+
+	template <typename V>
+	static V cosh(V x)
+	{
+		if constexpr (xsimd::is_batch<V>::value)
+			return xsimd::cosh(x);
+		else
+			return std::cosh(x);
+	}
+
+	template <typename V>
+	static V sqrt(V x)
+	{
+		if constexpr (xsimd::is_batch<V>::value)
+			return xsimd::sqrt(x);
+		else
+			return std::sqrt(x);
+	}
+};
+
+/* the fast_ approximations from FastMath.h, for control-rate updates while modulating */
+struct Fast
+{
+	template <typename V> static V exp(V x) { return fast_exp(x); }
+	template <typename V> static V cos(V x) { return fast_cos(x); }
+	template <typename V> static V cosh(V x) { return fast_cosh(x); }
+	template <typename V> static V sqrt(V x) { return Precise::sqrt(x); }
+};
+
+/* Poles of an analog resonator at w (radians/sample) with damping q, matched by impulse
+invariance, which is what keeps the matched designs from cramping */
+template <typename Math, typename V>
+void matchPoles(Coeffs<V> &c, V w, V q)
+{
+	using S = fast_math::ScalarType<V>;
+	const V zero = fast_math::constant<V>(0.0);
+
+	const V tmp = Math::exp(-q * w);
+	const V d = fast_math::constant<V>(1.0) - q * q;
+	const V wd = Math::sqrt(fast_math::max(d, -d)) * w;
+	if constexpr (xsimd::is_batch<V>::value)
+		c.a1 = S(-2.0) * tmp * fast_math::select(d >= zero, Math::cos(wd), Math::cosh(wd));
+	else
+		c.a1 = S(-2.0) * tmp * (d >= zero ? Math::cos(wd) : Math::cosh(wd));
+	c.a2 = tmp * tmp;
+}
+
+/* Only magnitudes with W^2 + B2 >= 0, where W = (sqrt(B0) + sqrt(B1)) / 2, can be factored.
+Below that the squared magnitude dips under zero somewhere between DC & Nyquist. */
+template <typename V>
+auto canMatchZeros(V B0, V B1, V B2)
+{
+	using S = fast_math::ScalarType<V>;
+	const V W = S(0.5) * (Precise::sqrt(B0) + Precise::sqrt(B1));
+	return W * W + B2 >= fast_math::constant<V>(0.0);
+}
+
+/* Factors the squared magnitude B0 * phi0 + B1 * phi1 + B2 * phi2 (Vicanek's notation, with
+phi1 = sin^2(w/2)) into b0, b1 & b2. Needs canMatchZeros(), and then the zeros always end up
+inside (or on) the unit circle */
+template <typename Math, typename V>
+void matchZeros(Coeffs<V> &c, V B0, V B1, V B2)
+{
+	using S = fast_math::ScalarType<V>;
+	const V zero = fast_math::constant<V>(0.0);
+
+	const V sqrtB0 = Math::sqrt(fast_math::max(B0, zero));
+	const V sqrtB1 = Math::sqrt(fast_math::max(B1, zero));
+	const V W = S(0.5) * (sqrtB0 + sqrtB1);
+
+	// max() only absorbs rounding, the caller has checked canMatchZeros()
+	c.b0 = S(0.5) * (W + Math::sqrt(fast_math::max(W * W + B2, zero)));
+	c.b1 = S(0.5) * (sqrtB0 - sqrtB1);
+	c.b2 = -B2 / (S(4.0) * c.b0);
+}
+
+/**
+ * Second-order shelf with linear gain at DC (lowshelf) or Nyquist (highshelf), after RBJ's
+ * analog prototypes. The poles are matched, then the zeros are fit so the magnitude is exact at
+ * DC, Nyquist & the cutoff (or half Nyquist, for cutoffs above that).
+ *
+ * With high cutoffs & a lot of gain, the poles (at cutoff * gain^(+/-1/4)) land near or past
+ * Nyquist, and the curve through those three points isn't a valid magnitude. Then lower match
+ * frequencies are tried, and as a last resort B2 = 0, i.e. only DC & Nyquist are matched. DC &
+ * Nyquist are always exact, and the result always stable & minimum phase.
+ *
+ * Against the analog prototype at 48kHz, with Q <= 1 & up to +/-24dB: within 0.5dB up to a
+ * cutoff of ~0.045 * fs, 1dB up to ~0.085 * fs & 3dB up to ~0.17 * fs. With up to +/-12dB,
+ * within 1dB up to ~0.24 * fs. Higher Q narrows this, to 1dB up to ~0.04 * fs at Q = 2 &
+ * ~0.017 * fs at Q = 4. Past that the shelf still has the right gains at both ends, but its
+ * transition no longer follows the prototype (worst of all, by over 10dB, with high Q & gain
+ * near Nyquist).
+ */
+template <typename Math, typename V>
+void matchShelf(Coeffs<V> &c, bool isHighShelf, V w0, V reso, V gain)
+{
+	using S = fast_math::ScalarType<V>;
+	const V one = fast_math::constant<V>(1.0), zero = fast_math::constant<V>(0.0);
+
+	const V A = Math::sqrt(gain), sqrtA = Math::sqrt(A);
+	const V q = S(0.5) / reso;
+
+	// numerator & denominator of H(s) with the cutoff at s = j
+	V n2, n1, n0, d2, d1, d0;
+	if (isHighShelf)
+	{
+		n2 = A * A; n1 = A * sqrtA / reso; n0 = A;
+		d2 = one; d1 = sqrtA / reso; d0 = A;
+		matchPoles<Math>(c, w0 * sqrtA, q);
+	}
+	else
+	{
+		n2 = A; n1 = A * sqrtA / reso; n0 = A * A;
+		d2 = A; d1 = sqrtA / reso; d0 = one;
+		matchPoles<Math>(c, w0 / sqrtA, q);
+	}
+
+	const auto magSquared = [&](V W) {
+		const V W2 = W * W;
+		const V nr = n0 - n2 * W2, ni = n1 * W, dr = d0 - d2 * W2, di = d1 * W;
+		return (nr * nr + ni * ni) / (dr * dr + di * di);
+	};
+
+	const V A0 = (one + c.a1 + c.a2) * (one + c.a1 + c.a2);
+	const V A1 = (one - c.a1 + c.a2) * (one - c.a1 + c.a2);
+	const V A2 = S(-4.0) * c.a2;
+
+	const V B0 = magSquared(zero) * A0;
+	const V B1 = magSquared(S(M_PI) / w0) * A1;
+
+	const auto fitB2 = [&](V wm) {
+		const V phi1 = S(0.5) * (one - Math::cos(wm)), phi0 = one - phi1;
+		const V Nm = magSquared(wm / w0) * (A0 * phi0 + A1 * phi1 + S(4.0) * A2 * phi0 * phi1);
+		return (Nm - B0 * phi0 - B1 * phi1) / (S(4.0) * phi0 * phi1);
+	};
+
+	const V halfPi = fast_math::constant<V>(0.5 * M_PI);
+	V wm = fast_math::select(w0 < halfPi, w0, halfPi);
+	V B2 = zero;
+	auto found = B0 < zero; // all false
+
+	for (int i = 0; i < 5; ++i, wm *= S(0.7))
+	{
+		const V candidate = fitB2(wm);
+		const auto ok = canMatchZeros(B0, B1, candidate);
+		B2 = fast_math::select(ok & !found, candidate, B2);
+		found = found | ok;
+
+		if constexpr (xsimd::is_batch<V>::value)
+		{
+			if (xsimd::all(found))
+				break;
+		}
+		else if (found)
+			break;
+	}
+
+	matchZeros<Math>(c, B0, B1, B2);
+}
+
+template <typename V, typename Math = Precise>
+Coeffs<V> calcCoeffs(FilterType type, V cutoff, V reso, V gain, double sampleRate)
+{
+	using S = fast_math::ScalarType<V>;
+	const V one = fast_math::constant<V>(1.0), zero = fast_math::constant<V>(0.0);
+
+	Coeffs<V> c { one, zero, zero, zero, zero };
+
+	// TODO: Better optimize based on filter type, since 1-pole filters
+	// require different zeroes than below
+	const V w0 = S(2.0 * M_PI / sampleRate) * cutoff;
+	const V q = S(0.5) / reso;
+	matchPoles<Math>(c, w0, q);
+
+	const V f0 = cutoff * S(2.0 / sampleRate);
+	const V freq2 = f0 * f0;
+	const V fac = (one - freq2) * (one - freq2);
+
+	switch (type) {
+	case lowpass: {
+		const V r0 = one + c.a1 + c.a2;
+		const V r1_num = (one - c.a1 + c.a2) * freq2;
+		const V r1_denom = Math::sqrt(fac + freq2 / (reso*reso));
+		const V r1 = r1_num / r1_denom;
+
+		c.b0 = (r0 + r1) * S(0.5);
+		c.b1 = r0 - c.b0;
+		c.b2 = zero;
+		break;
+	}
+	case highpass: {
+		const V r1_num = one - c.a1 + c.a2;
+		const V r1_denom = Math::sqrt(fac + freq2 / (reso*reso));
+		const V r1 = r1_num / r1_denom;
+
+		c.b0 = r1 * S(0.25);
+		c.b1 = S(-2.0) * c.b0;
+		c.b2 = c.b0;
+		break;
+	}
+	case bandpass: {
+		const V r0 = (one + c.a1 + c.a2) / (S(M_PI) * f0 * reso);
+		const V r1_num = (one - c.a1 + c.a2) * (f0 / reso);
+		const V r1_denom = Math::sqrt(fac + (freq2 / (reso*reso)));
+		const V r1 = r1_num / r1_denom;
+
+		c.b1 = -r1 * S(0.5);
+		c.b0 = (r0 - c.b1) * S(0.5);
+		c.b2 = -c.b0 - c.b1;
+		break;
+	}
+	case firstOrderHighpass: {
+		const V fc = cutoff * S(1.0 / sampleRate);
+		c.a1 = -Math::exp(fc * S(-2.0 * M_PI));
+		const V gain_nyq = Math::sqrt(S(0.25) / (S(0.25) + fc*fc));
+		c.b0 = S(0.5) * gain_nyq * (one - c.a1);
+		c.b1 = -c.b0;
+		c.a2 = c.b2 = zero;
+		break;
+	}
+	case firstOrderLowpass: {
+		const V fc = cutoff * S(1.0 / sampleRate);
+		c.a1 = -Math::exp(fc * S(-2.0 * M_PI));
+		const V gain_nyq = Math::sqrt(fc*fc / (S(0.25) + fc*fc));
+		c.b0 = S(0.5) * (gain_nyq * (one - c.a1) + one + c.a1);
+		c.b1 = one + c.a1 - c.b0;
+		c.a2 = c.b2 = zero;
+		break;
+	}
+	case firstOrderHighshelf: {
+		const V pi_sqr_2 = fast_math::constant<V>(2.0 / (M_PI*M_PI));
+		const V alpha = pi_sqr_2 * (one + one/(gain*freq2)) - S(0.5);
+		const V beta = pi_sqr_2 * (one + gain/freq2) - S(0.5);
+		c.a1 = -alpha / (one + alpha + Math::sqrt(one + S(2.0) * alpha));
+		const V b = -beta / (one + beta + Math::sqrt(one + S(2.0) * beta));
+		c.b0 = (one + c.a1) / (one + b);
+		c.b1 = b * c.b0;
+		c.a2 = c.b2 = zero;
+		break;
+	}
+	case firstOrderLowshelf: {
+		const V igain = one / gain;
+		const V pi_sqr_2 = fast_math::constant<V>(2.0 / (M_PI*M_PI));
+		const V alpha = pi_sqr_2 * (one + one/(igain*freq2)) - S(0.5);
+		const V beta = pi_sqr_2 * (one + igain/freq2) - S(0.5);
+		c.a1 = -alpha / (one + alpha + Math::sqrt(one + S(2.0) * alpha));
+		const V b = -beta / (one + beta + Math::sqrt(one + S(2.0) * beta));
+		c.b0 = gain * ((one + c.a1) / (one + b));
+		c.b1 = b * c.b0;
+		c.a2 = c.b2 = zero;
+		break;
+	}
+	case peak: {
+		// RBJ's bell, poles at damping q / sqrt(gain) so boosts & cuts are symmetric, and the
+		// zeros put the peak at the cutoff with exactly gain there & unity at DC
+		// (the fit stays factorable across 20 Hz..Nyquist, Q 0.3..8 & +/-30 dB, so no fallback)
+		matchPoles<Math>(c, w0, q / Math::sqrt(gain));
+
+		const V phi1 = S(0.5) * (one - Math::cos(w0)), phi0 = one - phi1;
+		const V A0 = (one + c.a1 + c.a2) * (one + c.a1 + c.a2);
+		const V A1 = (one - c.a1 + c.a2) * (one - c.a1 + c.a2);
+		const V A2 = S(-4.0) * c.a2;
+		const V G2 = gain * gain;
+
+		const V R1 = (A0 * phi0 + A1 * phi1 + S(4.0) * A2 * phi0 * phi1) * G2;
+		const V R2 = (A1 - A0 + S(4.0) * (phi0 - phi1) * A2) * G2;
+
+		const V B0 = A0;
+		const V B2 = (R1 - R2 * phi1 - B0) / (S(4.0) * phi1 * phi1);
+		const V B1 = R2 + B0 + S(4.0) * (phi1 - phi0) * B2;
+
+		matchZeros<Math>(c, B0, B1, B2);
+		break;
+	}
+	case notch: {
+		// zeros on the unit circle at the cutoff, unity gain at DC
+		const V cosw0 = Math::cos(w0);
+		c.b0 = (one + c.a1 + c.a2) / (S(2.0) - S(2.0) * cosw0);
+		c.b1 = S(-2.0) * cosw0 * c.b0;
+		c.b2 = c.b0;
+		break;
+	}
+	case allpass:
+		c.b0 = c.a2;
+		c.b1 = c.a1;
+		c.b2 = one;
+		break;
+	case lowshelf:
+		matchShelf<Math>(c, false, w0, reso, gain);
+		break;
+	case highshelf:
+		matchShelf<Math>(c, true, w0, reso, gain);
+		break;
+	default: break;
+	}
+
+	return c;
+}
+
+/**
+ * Coefficients for numBands filters at once, e.g. every band of an EQ, to be handed to each
+ * band's Filter::setCoeffs(). Runs of bands of the same type are calculated a full
+ * xsimd::batch<double> at a time, and registers with mixed types one band at a time.
+ */
+template <typename Math = Precise>
+void calcCoeffsForBands(const FilterType *types, const double *cutoffs, const double *resos, const double *gains,
+						size_t numBands, double sampleRate, Coeffs<double> *dest)
+{
+	using b_type = xsimd::batch<double>;
+	constexpr auto N = b_type::size;
+
+	size_t i = 0;
+	for (; i + N <= numBands; i += N)
+	{
+		if (! std::all_of(types + i, types + i + N, [&](FilterType t) { return t == types[i]; }))
+		{
+			for (size_t j = i; j < i + N; ++j)
+				dest[j] = calcCoeffs<double, Math>(types[j], cutoffs[j], resos[j], gains[j], sampleRate);
+			continue;
+		}
+
+		const auto c = calcCoeffs<b_type, Math>(types[i], b_type::load_unaligned(cutoffs + i), b_type::load_unaligned(resos + i),
+												 b_type::load_unaligned(gains + i), sampleRate);
+
+		alignas (b_type::arch_type::alignment()) double lanes[5][N];
+		c.b0.store_aligned(lanes[0]);
+		c.b1.store_aligned(lanes[1]);
+		c.b2.store_aligned(lanes[2]);
+		c.a1.store_aligned(lanes[3]);
+		c.a2.store_aligned(lanes[4]);
+
+		for (size_t j = 0; j < N; ++j)
+			dest[i + j] = { lanes[0][j], lanes[1][j], lanes[2][j], lanes[3][j], lanes[4][j] };
+	}
+
+	for (; i < numBands; ++i)
+		dest[i] = calcCoeffs<double, Math>(types[i], cutoffs[i], resos[i], gains[i], sampleRate);
+}
+} // namespace matched_filter
+
 template <typename T>
 struct Filter
 {
@@ -40,113 +414,22 @@ struct Filter
 
 		// setCoeffs();
 
-		xn[0].resize(numChannels);
-		xn[1].resize(numChannels);
-		yn[0].resize(numChannels);
-		yn[1].resize(numChannels);
-
-		for (auto &x : xn)
-			for (auto &ch : x)
-				ch = 0.0;
-
-		for (auto &y : yn)
-			for (auto &ch : y)
-				ch = 0.0;
+		state.assign(numChannels, State{});
 	}
 	
 	void setCoeffs()
 	{
-		// TODO: Better optimize based on filter type, since 1-pole filters
-		// require different zeroes than below
-		const auto w0 = 2.0 * M_PI * (cutoff / sampleRate);
-		const auto q = 1.0 / (2.0 * reso);
-		const auto tmp = exp(-q * w0);
-		a1 = -2.0 * tmp;
-		if (q <= 1.0)
-			a1 *= cos(sqrt(1.0 - q * q) * w0);
-		else
-			a1 *= cosh(sqrt(q * q - 1.0) * w0);
-		a2 = tmp * tmp;
-
-		const auto f0 = cutoff / (sampleRate * 0.5);
-		const auto freq2 = f0 * f0;
-		const auto fac = (1.0 - freq2) * (1.0 - freq2);
-
-		double r0, r1, r1_num, r1_denom;
-		switch (type) {
-		case lowpass:
-			r0 = 1.0 + a1 + a2;
-			r1_num = (1.0 - a1 + a2) * freq2;
-			r1_denom = sqrt(fac + freq2 / (reso*reso));
-			r1 = r1_num / r1_denom;
-
-			b0 = (r0 + r1) / 2.0;
-			b1 = r0 - b0;
-			b2 = 0.0;
-			break;
-		case highpass:
-			r1_num = 1.0 - a1 + a2;
-			r1_denom = sqrt(fac + freq2 / (reso*reso));
-			r1 = r1_num / r1_denom;
-
-			b0 = r1 / 4.0;
-			b1 = -2.0 * b0;
-			b2 = b0;
-			break;
-		case bandpass:
-			r0 = (1.0 + a1 + a2) / (M_PI * f0 * reso);
-			r1_num = (1.0 - a1 + a2) * (f0 / reso);
-			r1_denom = sqrt(fac + (freq2 / (reso*reso)));
-			r1 = r1_num / r1_denom;
-
-			b1 = -r1 / 2.0;
-			b0 = (r0 - b1) / 2.0;
-			b2 = -b0 - b1;
-			break;
-		case firstOrderHighpass: {
-			auto fc = cutoff / sampleRate;
-			a1 = -exp(-fc * 2.0 * M_PI);
-			const auto gain_nyq = sqrt(0.25 / (0.25 + fc*fc));
-			b0 = 0.5 * gain_nyq * (1.0 - a1);
-			b1 = -b0;
-			a2 = b2 = 0.0;
-			break;
-		}
-		case firstOrderLowpass: {
-			auto fc = cutoff / sampleRate;
-			a1 = -exp(-fc * 2.0 * M_PI);
-			const auto gain_nyq = sqrt(fc*fc / (0.25 + fc*fc));
-			b0 = 0.5 * (gain_nyq * (1.0 - a1) + 1 + a1);
-			b1 = 1.0 + a1 - b0;
-			a2 = b2 = 0.0;
-			break;
-		}
-		case firstOrderHighshelf: {
-			const auto pi_sqr_2 = 2.0 / (M_PI*M_PI);
-			const auto alpha = pi_sqr_2 * (1 + 1/(gain*freq2)) - 0.5;
-			const auto beta = pi_sqr_2 * (1 + gain/freq2) - 0.5;
-			a1 = -alpha / (1.0 + alpha + sqrt(1.0 + 2.0 * alpha));
-			const auto b = -beta / (1.0 + beta + sqrt(1.0 + 2.0 * beta));
-			b0 = (1.0 + a1) / (1.0 + b);
-			b1 = b * b0;
-			a2 = b2 = 0.0;
-			break;
-		}
-		case firstOrderLowshelf: {
-			auto igain = 1.0 / gain;
-			const auto pi_sqr_2 = 2.0 / (M_PI*M_PI);
-			const auto alpha = pi_sqr_2 * (1 + 1/(igain*freq2)) - 0.5;
-			const auto beta = pi_sqr_2 * (1 + igain/freq2) - 0.5;
-			a1 = -alpha / (1.0 + alpha + sqrt(1.0 + 2.0 * alpha));
-			const auto b = -beta / (1.0 + beta + sqrt(1.0 + 2.0 * beta));
-			b0 = gain * ((1.0 + a1) / (1.0 + b));
-			b1 = b * b0;
-			a2 = b2 = 0.0;
-			break;
-		} default: break;
-		}
+		coeffs = matched_filter::calcCoeffs(type, cutoff, reso, gain, sampleRate);
 	}
 
+	/* coefficients calculated elsewhere, e.g. by matched_filter::calcCoeffsForBands() */
+	void setCoeffs(const matched_filter::Coeffs<double> &newCoeffs)
+	{
+		coeffs = newCoeffs;
+	}
+
+	const matched_filter::Coeffs<double> &getCoeffs() const { return coeffs; }
+
 	void setCutoff(double newCutoff)
 	{
 		cutoff = newCutoff;
@@ -159,62 +442,278 @@ struct Filter
 		setCoeffs();
 	}
 
+	void setGain(double newGain)
+	{
+		gain = newGain;
+		setCoeffs();
+	}
+
 	void reset()
 	{
-		for (auto &x : xn)
-			for (auto &ch : x)
-				ch = 0.0;
-		for (auto &y : yn)
-			for (auto &ch : y)
-				ch = 0.0;
+		std::fill(state.begin(), state.end(), State{});
 	}
 
 	T processSample(int ch, T x)
 	{
-		const auto b = b0 * x + b1 * xn[0][ch] + b2 * xn[1][ch];
-		const auto a = -a1 * yn[0][ch] - a2 * yn[1][ch];
-
-		const auto out = a + b;
-		xn[1][ch] = xn[0][ch];
-		xn[0][ch] = x;
-		yn[1][ch] = yn[0][ch];
-		yn[0][ch] = out;
+		auto &s = state[ch];
+		const T out = coeffs.b0 * x + s.s1;
+		s.s1 = coeffs.b1 * x - coeffs.a1 * out + s.s2;
+		s.s2 = coeffs.b2 * x - coeffs.a2 * out;
 		return out;
 	}
 
+	/* processes in place */
 	void process(T **in, size_t numChannels, size_t numSamples)
 	{
-		assert(numChannels <= xn[0].size());
-
-		for (size_t ch = 0; ch < numChannels; ++ch)
-			for (size_t i = 0; i < numSamples; ++i)
-				processSample(ch, in[ch][i]);
+		assert(numChannels <= state.size());
+		processChannels<false>([in](size_t ch) { return in[ch]; }, numChannels, numSamples, {});
 	}
 
 	void processBlock(juce::dsp::AudioBlock<T> block)
 	{
 		const auto numChannels = block.getNumChannels();
-		const auto numSamples = block.getNumSamples();
-		assert(numChannels <= xn[0].size());
+		assert(numChannels <= state.size());
+		processChannels<false>([&block](size_t ch) { return block.getChannelPointer(ch); }, numChannels, block.getNumSamples(), {});
+	}
 
-		for (size_t ch = 0; ch < numChannels; ++ch)
+	/* samples between coefficient updates in processModulated() & processSmoothed() */
+	void setControlInterval(size_t numSamples)
+	{
+		controlInterval = std::max((size_t)1, numSamples);
+	}
+
+	/**
+	 * Processes in place with cutoff & reso changing per sample, e.g. from an envelope follower.
+	 * Coefficients are only calculated once per control interval, from the parameters at the end
+	 * of it, and ramped linearly towards from the previous ones in between. Ramping a1 & a2 in a
+	 * straight line between two stable filters stays stable. Math picks the functions used for
+	 * the control points, matched_filter::Fast or matched_filter::Precise.
+	 * Either buffer can be nullptr to hold that parameter where it is.
+	 */
+	template <typename Math = matched_filter::Fast, typename P>
+	void processModulated(T **in, size_t numChannels, size_t numSamples, const P *cutoffs, const P *resos)
+	{
+		assert(numChannels <= state.size());
+
+		for (size_t start = 0; start < numSamples; start += controlInterval)
 		{
-			auto in = block.getChannelPointer(ch);
-			for (size_t i = 0; i < numSamples; ++i)
-				in[i] = processSample(ch, in[i]);
+			const auto n = std::min(controlInterval, numSamples - start);
+			if (cutoffs)
+				cutoff = (double)cutoffs[start + n - 1];
+			if (resos)
+				reso = (double)resos[start + n - 1];
+
+			rampCoeffs<Math>([in, start](size_t ch) { return in[ch] + start; }, numChannels, n);
 		}
 	}
 
-	double cutoff, reso, gain;
+	/* The same, reading a pair of juce::SmoothedValue (or anything with skip()) once per control
+	interval instead of from buffers */
+	template <typename Math = matched_filter::Fast, typename Smoother>
+	void processSmoothed(T **in, size_t numChannels, size_t numSamples, Smoother &cutoffSmoother, Smoother &resoSmoother)
+	{
+		assert(numChannels <= state.size());
+
+		for (size_t start = 0; start < numSamples; start += controlInterval)
+		{
+			const auto n = std::min(controlInterval, numSamples - start);
+			cutoff = (double)cutoffSmoother.skip((int)n);
+			reso = (double)resoSmoother.skip((int)n);
+
+			rampCoeffs<Math>([in, start](size_t ch) { return in[ch] + start; }, numChannels, n);
+		}
+	}
+
+	double cutoff = 1000.0, reso = 0.7071, gain = 1.0;
 
 private:
+	/* transposed direct form II, so each channel only carries two state variables */
+	struct State
+	{
+		T s1 = 0, s2 = 0;
+	};
+
+	using Coeffs = matched_filter::Coeffs<double>;
+
+	template <typename V>
+	static matched_filter::Coeffs<V> broadcast(const Coeffs &c)
+	{
+		using fast_math::constant;
+		return { constant<V>(c.b0), constant<V>(c.b1), constant<V>(c.b2), constant<V>(c.a1), constant<V>(c.a2) };
+	}
+
+	template <typename V>
+	static void step(matched_filter::Coeffs<V> &c, const matched_filter::Coeffs<V> &inc)
+	{
+		c.b0 += inc.b0;
+		c.b1 += inc.b1;
+		c.b2 += inc.b2;
+		c.a1 += inc.a1;
+		c.a2 += inc.a2;
+	}
+
+	/* filters n samples from each channel while ramping to the coefficients for the current
+	cutoff & reso, landing on them exactly at the last sample */
+	template <typename Math, typename ChannelFn>
+	void rampCoeffs(ChannelFn &&getChannel, size_t numChannels, size_t n)
+	{
+		const auto target = matched_filter::calcCoeffs<double, Math>(type, cutoff, reso, gain, sampleRate);
+		const auto scale = 1.0 / (double)n;
+		const Coeffs inc { (target.b0 - coeffs.b0) * scale, (target.b1 - coeffs.b1) * scale, (target.b2 - coeffs.b2) * scale,
+						   (target.a1 - coeffs.a1) * scale, (target.a2 - coeffs.a2) * scale };
+
+		processChannels<true>(getChannel, numChannels, n, inc);
+		coeffs = target;
+	}
+
+	template <bool ramp, typename ChannelFn>
+	void processChannels(ChannelFn &&getChannel, size_t numChannels, size_t numSamples, const Coeffs &inc)
+	{
+		size_t ch = 0;
+		if constexpr (std::is_floating_point_v<T>)
+		{
+			// pairs go in a 2-lane batch where the arch has one (e.g. doubles on SSE2/NEON),
+			// everything else fills as many lanes of a full batch as there are channels
+			using pair_type = xsimd::make_sized_batch_t<T, 2>;
+			using b_type = xsimd::batch<T>;
+
+			for (; ch + b_type::size <= numChannels; ch += b_type::size)
+				processGroup<ramp, b_type>(getChannel, ch, b_type::size, numSamples, inc);
+
+			if constexpr (std::is_void_v<pair_type>)
+			{
+				if (ch + 1 < numChannels)
+				{
+					processGroup<ramp, b_type>(getChannel, ch, numChannels - ch, numSamples, inc);
+					ch = numChannels;
+				}
+			}
+			else
+			{
+				for (; ch + 1 < numChannels; ch += 2)
+					processGroup<ramp, pair_type>(getChannel, ch, 2, numSamples, inc);
+			}
+		}
+
+		for (; ch < numChannels; ++ch)
+			processChannel<ramp>(getChannel(ch), numSamples, state[ch], inc);
+	}
+
+	/* state is kept in locals for the whole block, and written back once at the end */
+	template <bool ramp>
+	void processChannel(T *x, size_t numSamples, State &state, const Coeffs &inc)
+	{
+		auto c = broadcast<T>(coeffs);
+		const auto dc = broadcast<T>(inc);
+		auto s1 = state.s1, s2 = state.s2;
+
+		for (size_t i = 0; i < numSamples; ++i)
+		{
+			if constexpr (ramp)
+				step(c, dc);
+
+			const auto in = x[i];
+			const T out = c.b0 * in + s1;
+			s1 = c.b1 * in - c.a1 * out + s2;
+			s2 = c.b2 * in - c.a2 * out;
+			x[i] = out;
+		}
+
+		state.s1 = s1;
+		state.s2 = s2;
+	}
+
+	/* Up to b_type::size channels share one register. The recursion is latency bound, so a
+	group runs in about the time of one channel. Each chunk of b_type::size samples is
+	transposed in-register so every row holds one sample of all channels, filtered, and
+	transposed back; lanes past numInGroup carry zeros and are never written out */
+	template <bool ramp, typename b_type, typename ChannelFn>
+	void processGroup(ChannelFn &&getChannel, size_t firstChannel, size_t numInGroup, size_t numSamples, const Coeffs &inc)
+	{
+		constexpr auto N = b_type::size;
+		constexpr auto alignment = b_type::arch_type::alignment();
+		assert(numInGroup > 1 && numInGroup <= N);
+
+		T *x[N] {};
+		alignas (alignment) T s1Lanes[N] {}, s2Lanes[N] {};
+		for (size_t k = 0; k < numInGroup; ++k)
+		{
+			x[k] = getChannel(firstChannel + k);
+			s1Lanes[k] = state[firstChannel + k].s1;
+			s2Lanes[k] = state[firstChannel + k].s2;
+		}
+
+		auto c = broadcast<b_type>(coeffs);
+		const auto dc = broadcast<b_type>(inc);
+		auto s1 = b_type::load_aligned (s1Lanes);
+		auto s2 = b_type::load_aligned (s2Lanes);
+
+		const auto filterRows = [&](b_type (&rows)[N], size_t n) {
+			simd_transpose::transpose (rows);
+
+			for (size_t j = 0; j < n; ++j)
+			{
+				if constexpr (ramp)
+					step(c, dc);
+
+				const auto in = rows[j];
+				const auto out = c.b0 * in + s1;
+				s1 = c.b1 * in - c.a1 * out + s2;
+				s2 = c.b2 * in - c.a2 * out;
+				rows[j] = out;
+			}
+
+			simd_transpose::transpose (rows);
+		};
+
+		size_t start = 0;
+		for (; start + N <= numSamples; start += N)
+		{
+			b_type rows[N];
+			for (size_t k = 0; k < N; ++k)
+				rows[k] = k < numInGroup ? b_type::load_unaligned (x[k] + start) : b_type (T (0));
+
+			filterRows (rows, N);
+
+			for (size_t k = 0; k < numInGroup; ++k)
+				rows[k].store_unaligned (x[k] + start);
+		}
+
+		if (start < numSamples)
+		{
+			const auto n = numSamples - start;
+			alignas (alignment) T tail[N][N] {};
+			for (size_t k = 0; k < numInGroup; ++k)
+				std::copy (x[k] + start, x[k] + numSamples, tail[k]);
+
+			b_type rows[N];
+			for (size_t k = 0; k < N; ++k)
+				rows[k] = b_type::load_aligned (tail[k]);
+
+			filterRows (rows, n);
+
+			for (size_t k = 0; k < numInGroup; ++k)
+			{
+				rows[k].store_aligned (tail[k]);
+				std::copy (tail[k], tail[k] + n, x[k] + start);
+			}
+		}
+
+		s1.store_aligned (s1Lanes);
+		s2.store_aligned (s2Lanes);
+		for (size_t k = 0; k < numInGroup; ++k)
+		{
+			state[firstChannel + k].s1 = s1Lanes[k];
+			state[firstChannel + k].s2 = s2Lanes[k];
+		}
+	}
 
 	FilterType type;
 
 	double sampleRate = 44100.0;
-	
-	std::vector<T> xn [2];
-	std::vector<T> yn [2];
+	size_t controlInterval = 32;
+
+	std::vector<State> state;
 
-	double a1, a2, b0, b1, b2;
+	Coeffs coeffs { 1.0, 0.0, 0.0, 0.0, 0.0 };
 };
@@ -44,6 +44,32 @@ public:
         reset();
     }
 
+    /* true once the filter state has decayed below silence::threshold */
+    bool isStateSilent() const noexcept
+    {
+        for (size_t i = 0; i < order; ++i)
+            if (!silence::isBelow(state[i]))
+                return false;
+
+        return true;
+    }
+
+    /* process() that leaves the block untouched if the input is known to be silent
+    and the state has decayed */
+    template <typename Block>
+    void process(Block& block, bool inputIsSilent) noexcept
+    {
+        check();
+
+        if (inputIsSilent && isStateSilent())
+        {
+            reset();
+            return;
+        }
+
+        process(block);
+    }
+
     template <typename Block>
     void process(Block& block) noexcept
     {
@@ -73,6 +99,8 @@ public:
 
                     lv1 = (input * b1) - (output * a1);
                 }
+
+                state[0] = lv1;
             }
             break;
 
@@ -96,6 +124,9 @@ public:
                     lv1 = (input * b1) - (output* a1) + lv2;
                     lv2 = (input * b2) - (output* a2);
                 }
+
+                state[0] = lv1;
+                state[1] = lv2;
             }
             break;
 
@@ -123,6 +154,10 @@ public:
                     lv2 = (input * b2) - (output* a2) + lv3;
                     lv3 = (input * b3) - (output* a3);
                 }
+
+                state[0] = lv1;
+                state[1] = lv2;
+                state[2] = lv3;
             }
             break;
 
@@ -69,7 +69,40 @@ public:
             std::fill (s->begin(), s->end(), static_cast<SampleType> (0));
     }
 
+    /** Returns true once every channel's state has decayed below silence::threshold. */
+    bool isStateSilent() const noexcept
+    {
+        for (auto s : { &s1, &s2, &s3, &s4 })
+            for (auto& v : *s)
+                if (! silence::isBelow (v))
+                    return false;
+
+        return true;
+    }
+
     //==============================================================================
+    /** Processes a context whose input may be known to be silent.
+
+        If it is, and the filter state has decayed, the filter is skipped and the
+        output is just cleared (or left alone, when processing in place).
+    */
+    template <typename ProcessContext>
+    void process (const ProcessContext& context, bool inputIsSilent) noexcept
+    {
+        if (inputIsSilent && ! context.isBypassed && isStateSilent())
+        {
+            reset();
+
+            auto& outputBlock = context.getOutputBlock();
+            if (context.getInputBlock().getChannelPointer (0) != outputBlock.getChannelPointer (0))
+                outputBlock.clear();
+
+            return;
+        }
+
+        process (context);
+    }
+
     /** Processes the input and output samples supplied in the processing context. */
     template <typename ProcessContext>
     void process (const ProcessContext& context) noexcept
@@ -153,16 +186,18 @@ private:
     //==============================================================================
     void update()
     {
-        if constexpr (std::is_same<SampleType, double>::value) {
+        using NumericType = buffer_ops::NumericType<SampleType>;
+
+        if constexpr (std::is_floating_point<SampleType>::value) {
             g  = (SampleType) std::tan (MathConstants<double>::pi * cutoffFrequency / sampleRate);
             R2 = (SampleType) std::sqrt (2.0);
         }
         else {
-            g = xsimd::tan (MathConstants<double>::pi * cutoffFrequency / sampleRate);
-            R2 = xsimd::sqrt (2.0);
+            g = xsimd::tan (SampleType ((NumericType) (MathConstants<double>::pi / sampleRate)) * cutoffFrequency);
+            R2 = SampleType ((NumericType) std::sqrt (2.0));
         }
-        
-        h  = (SampleType) (1.0 / (1.0 + R2 * g + g * g));
+
+        h  = (SampleType) 1 / ((SampleType) 1 + R2 * g + g * g);
     }
 
     //==============================================================================
@@ -0,0 +1,213 @@
+/**
+ * LevelHistory.h
+ * Scrolling level/waveform history, kept at every zoom level at once
+*/
+#pragma once
+
+/**
+ * Fed from the audio thread the same way as VolumeMeterSource::copyBuffer(). The audio
+ * thread only reduces each run of samplesPerBucket samples to a min/max/mean-square bucket
+ * (across all channels) and hands it over through a FIFO.
+ *
+ * On the message thread, update() adds the new buckets to a pyramid. Level 0 holds one
+ * bucket per samplesPerBucket samples, and each level above merges pairs of buckets from the
+ * one below, so it covers twice the time. Each level is a fixed-size ring, so memory doesn't
+ * grow, and the top levels reach back much further than the bottom ones.
+ *
+ * getHistory() reads from the level closest to the requested zoom, so a view costs
+ * O(pixels) at any zoom. The newest pixel can lag by up to one pixel's worth of audio,
+ * until the level it's read from has its next bucket.
+ */
+class LevelHistorySource
+{
+public:
+    struct Bucket
+    {
+        float min = 0.f, max = 0.f, meanSquare = 0.f;
+
+        float getRMS() const { return std::sqrt(meanSquare); }
+
+        /* two buckets of the same length */
+        static Bucket merge(const Bucket &a, const Bucket &b)
+        {
+            return {jmin(a.min, b.min), jmax(a.max, b.max), 0.5f * (a.meanSquare + b.meanSquare)};
+        }
+    };
+
+    /**
+     * @param samplesPerBucket resolution of the most zoomed in level
+     * @param bucketsPerLevel length of each level's ring
+     * @param numLevels with the defaults, level 0 covers ~2.7s and level 11 ~90min at 48kHz
+     */
+    void prepare(const dsp::ProcessSpec &spec, size_t samplesPerBucket = 64, size_t bucketsPerLevel = 2048, size_t numLevels = 12)
+    {
+        jassert(samplesPerBucket > 0 && bucketsPerLevel > 0 && numLevels > 0);
+
+        sampleRate = spec.sampleRate;
+        bucketSize = samplesPerBucket;
+        levels.assign(numLevels, Level{});
+        for (auto &level : levels)
+            level.ring.assign(bucketsPerLevel, Bucket{});
+
+        // room for ~1s of buckets between update() calls
+        incoming.assign((size_t)jmax(64.0, spec.sampleRate / (double)samplesPerBucket), Bucket{});
+        fifo.setTotalSize((int)incoming.size());
+
+        reset();
+    }
+
+    /* not safe during copyBuffer() */
+    void reset()
+    {
+        fifo.reset();
+        currentCount = 0;
+        currentMin = currentMax = 0.f;
+        currentSumOfSquares = 0.0;
+
+        for (auto &level : levels)
+        {
+            std::fill(level.ring.begin(), level.ring.end(), Bucket{});
+            level.numWritten = 0;
+            level.hasPending = false;
+        }
+    }
+
+    // lock-free method for copying data to the history
+    template <typename T>
+    void copyBuffer(const T *const *buffer, size_t numChannels, size_t numSamples)
+    {
+        if (numChannels == 0)
+            return;
+
+        for (size_t offset = 0; offset < numSamples;)
+        {
+            const auto n = jmin(numSamples - offset, bucketSize - currentCount);
+
+            for (size_t ch = 0; ch < numChannels; ++ch)
+            {
+                T lo, hi, sumOfSquares;
+                buffer_ops::minMaxAndSumOfSquares(buffer[ch] + offset, n, lo, hi, sumOfSquares);
+
+                const auto first = currentCount == 0 && ch == 0;
+                currentMin = first ? (float)lo : jmin(currentMin, (float)lo);
+                currentMax = first ? (float)hi : jmax(currentMax, (float)hi);
+                currentSumOfSquares += (double)sumOfSquares / (double)numChannels;
+            }
+
+            currentCount += n;
+            offset += n;
+
+            if (currentCount == bucketSize)
+            {
+                // if the message thread's fallen behind, the bucket is dropped
+                const auto scope = fifo.write(jmin(1, fifo.getFreeSpace()));
+                if (scope.blockSize1 > 0)
+                    incoming[(size_t)scope.startIndex1] = {currentMin, currentMax, (float)(currentSumOfSquares / (double)bucketSize)};
+
+                currentCount = 0;
+                currentSumOfSquares = 0.0;
+            }
+        }
+    }
+
+    void copyBuffer(const AudioBuffer<float> &buffer)
+    {
+        copyBuffer(buffer.getArrayOfReadPointers(), (size_t)buffer.getNumChannels(), (size_t)buffer.getNumSamples());
+    }
+
+    /* Adds whatever the audio thread has handed over to the pyramid. Call from the message
+    thread before drawing, e.g. from a MeterRefreshHub::Attachment's refresh */
+    void update()
+    {
+        const auto scope = fifo.read(fifo.getNumReady());
+        scope.forEach([this](int index) { push(0, incoming[(size_t)index]); });
+    }
+
+    /**
+     * Fills one bucket per pixel, oldest first, with the most recent numPixels * samplesPerPixel
+     * samples. Pixels from before the history starts are left as empty buckets.
+     * Message thread only.
+     */
+    void getHistory(Bucket *dest, size_t numPixels, double samplesPerPixel) const
+    {
+        if (levels.empty() || numPixels == 0)
+            return;
+
+        // the coarsest level that still has at least one bucket per pixel
+        const auto bucketsPerPixelAtZero = jmax(1.0, samplesPerPixel / (double)bucketSize);
+        const auto levelIndex = (size_t)jlimit(0, (int)levels.size() - 1, (int)std::floor(std::log2(bucketsPerPixelAtZero)));
+        const auto &level = levels[levelIndex];
+
+        const auto bucketsPerPixel = bucketsPerPixelAtZero / (double)((size_t)1 << levelIndex);
+        const auto capacity = (uint64_t)level.ring.size();
+        const auto oldest = level.numWritten > capacity ? level.numWritten - capacity : 0;
+        const auto end = (double)level.numWritten;
+
+        for (size_t p = 0; p < numPixels; ++p)
+        {
+            const auto pixelStart = end - (double)(numPixels - p) * bucketsPerPixel;
+            const auto first = (int64_t)std::floor(pixelStart);
+            const auto last = jmax(first + 1, (int64_t)std::floor(pixelStart + bucketsPerPixel));
+
+            const auto from = jmax(first, (int64_t)oldest), to = jmin(last, (int64_t)level.numWritten);
+
+            Bucket b;
+            for (auto i = from; i < to; ++i)
+            {
+                const auto &bucket = level.ring[(size_t)((uint64_t)i % capacity)];
+                b = i == from ? bucket : Bucket{jmin(b.min, bucket.min), jmax(b.max, bucket.max), b.meanSquare + bucket.meanSquare};
+            }
+
+            if (to - from > 1)
+                b.meanSquare /= (float)(to - from);
+
+            dest[p] = b;
+        }
+    }
+
+    /* samples covered by each bucket of the most zoomed in level */
+    size_t getSamplesPerBucket() const { return bucketSize; }
+    double getSampleRate() const { return sampleRate; }
+
+private:
+    struct Level
+    {
+        std::vector<Bucket> ring;
+        uint64_t numWritten = 0;
+        Bucket pending; // first of a pair waiting to be merged into the next level
+        bool hasPending = false;
+    };
+
+    void push(size_t levelIndex, const Bucket &bucket)
+    {
+        auto &level = levels[levelIndex];
+        level.ring[(size_t)(level.numWritten % level.ring.size())] = bucket;
+        ++level.numWritten;
+
+        if (levelIndex + 1 == levels.size())
+            return;
+
+        if (level.hasPending)
+        {
+            level.hasPending = false;
+            push(levelIndex + 1, Bucket::merge(level.pending, bucket));
+        }
+        else
+        {
+            level.pending = bucket;
+            level.hasPending = true;
+        }
+    }
+
+    double sampleRate = 44100.0;
+    size_t bucketSize = 64;
+    std::vector<Level> levels;
+
+    /* audio thread: the bucket being filled */
+    size_t currentCount = 0;
+    float currentMin = 0.f, currentMax = 0.f;
+    double currentSumOfSquares = 0.0;
+
+    AbstractFifo fifo{64};
+    std::vector<Bucket> incoming;
+};
@@ -0,0 +1,281 @@
+/**
+ * LookupTable.h
+ * Interpolated lookup tables for waveshapers & other expensive functions, built at compile time
+ * where the compiler allows it, and shared by everything in the process
+*/
+#pragma once
+
+/* Just enough constexpr math to fill tables at compile time. Accurate to ~1e-15, but slow,
+so don't call these per-sample */
+namespace constexpr_math
+{
+constexpr double pi = 3.14159265358979323846;
+constexpr double ln2 = 0.69314718055994530942;
+
+constexpr double exp(double x)
+{
+    if (x > 709.0)
+        return exp(709.0);
+    if (x < -745.0)
+        return 0.0;
+
+    // x = k * ln2 + r, |r| <= ln2 / 2
+    const auto k = (long long)(x / ln2 + (x < 0.0 ? -0.5 : 0.5));
+    const auto r = x - (double)k * ln2;
+
+    double term = 1.0, sum = 1.0;
+    for (int n = 1; n < 20; ++n)
+    {
+        term *= r / n;
+        sum += term;
+    }
+
+    for (auto i = k; i > 0; --i)
+        sum *= 2.0;
+    for (auto i = k; i < 0; ++i)
+        sum *= 0.5;
+
+    return sum;
+}
+
+constexpr double tanh(double x)
+{
+    if (x < 0.0)
+        return -tanh(-x);
+    if (x > 20.0)
+        return 1.0;
+
+    return 1.0 - 2.0 / (exp(2.0 * x) + 1.0);
+}
+
+constexpr double sin(double x)
+{
+    // wrap to [-pi, pi]
+    const auto turns = (long long)(x / (2.0 * pi) + (x < 0.0 ? -0.5 : 0.5));
+    x -= (double)turns * 2.0 * pi;
+
+    double term = x, sum = x;
+    for (int n = 1; n < 15; ++n)
+    {
+        term *= -x * x / ((2 * n) * (2 * n + 1));
+        sum += term;
+    }
+
+    return sum;
+}
+
+constexpr double cos(double x) { return sin(x + 0.5 * pi); }
+
+constexpr double atan(double x)
+{
+    if (x < 0.0)
+        return -atan(-x);
+    if (x > 1.0)
+        return 0.5 * pi - atan(1.0 / x);
+
+    // Euler's series, which converges at least as fast as 2^-n for |x| <= 1
+    const auto y = x * x / (1.0 + x * x);
+    double term = x / (1.0 + x * x), sum = term;
+    for (int n = 1; n < 60; ++n)
+    {
+        term *= y * (2.0 * n) / (2.0 * n + 1.0);
+        sum += term;
+    }
+
+    return sum;
+}
+}
+
+enum class Interpolation
+{
+    linear,
+    cubic // Catmull-Rom
+};
+
+/**
+ * A function sampled at N + 1 evenly spaced points over [minInput, maxInput], plus a
+ * guard point at each end so cubic interpolation never reads past the table.
+ * Inputs outside the range are clamped to it.
+ *
+ * The constructor is constexpr, so a table of a constexpr function (anything in
+ * constexpr_math, or a lambda that only does arithmetic) can be built by the compiler:
+ *
+ *     inline const LookupTable<float, 1024> curve { [] (double x) { return x / (1.0 + x * x); }, -4.0, 4.0 };
+ *
+ * Declare tables as inline or static variables so all instances share one copy. Big tables
+ * can run into the compiler's constexpr step limit, in which case a non-constexpr
+ * variable like the one above is just filled in at startup instead.
+ *
+ * Evaluates scalars, or xsimd registers by gathering each lane's neighbours.
+*/
+template <typename T, size_t N>
+struct LookupTable
+{
+    static_assert(std::is_floating_point_v<T>, "Tables hold float or double");
+    static_assert(N >= 2, "A table needs at least 2 intervals");
+
+    template <typename Function>
+    constexpr LookupTable(Function &&function, double minInputToUse, double maxInputToUse)
+        : minInput((T)minInputToUse), maxInput((T)maxInputToUse),
+          invStep((T)((double)N / (maxInputToUse - minInputToUse)))
+    {
+        const auto step = (maxInputToUse - minInputToUse) / (double)N;
+
+        for (size_t i = 0; i < N + 3; ++i)
+            data[i] = (T)function(minInputToUse + ((double)i - 1.0) * step);
+    }
+
+    template <Interpolation I = Interpolation::cubic, typename V>
+    V process(V x) const noexcept
+    {
+        if constexpr (I == Interpolation::linear)
+            return processLinear(x);
+        else
+            return processCubic(x);
+    }
+
+    template <typename V>
+    V operator()(V x) const noexcept { return processCubic(x); }
+
+    template <typename V>
+    V processLinear(V x) const noexcept
+    {
+        V frac;
+        const auto i = index(x, frac);
+
+        const auto y1 = at(i, 1);
+        const auto y2 = at(i, 2);
+
+        return y1 + frac * (y2 - y1);
+    }
+
+    template <typename V>
+    V processCubic(V x) const noexcept
+    {
+        V frac;
+        const auto i = index(x, frac);
+
+        const auto y0 = at(i, 0);
+        const auto y1 = at(i, 1);
+        const auto y2 = at(i, 2);
+        const auto y3 = at(i, 3);
+
+        const auto c1 = V(T(0.5)) * (y2 - y0);
+        const auto c2 = y0 - V(T(2.5)) * y1 + V(T(2)) * y2 - V(T(0.5)) * y3;
+        const auto c3 = V(T(0.5)) * (y3 - y0) + V(T(1.5)) * (y1 - y2);
+
+        return ((c3 * frac + c2) * frac + c1) * frac + y1;
+    }
+
+    /* Runs a whole buffer through the table, a register at a time */
+    template <Interpolation I = Interpolation::cubic>
+    void process(const T *in, T *out, size_t numSamples) const noexcept
+    {
+        using b_type = xsimd::batch<T>;
+        const auto vecEnd = numSamples - numSamples % b_type::size;
+        size_t i = 0;
+
+        for (; i < vecEnd; i += b_type::size)
+            process<I>(b_type::load_unaligned(in + i)).store_unaligned(out + i);
+
+        for (; i < numSamples; ++i)
+            out[i] = process<I>(in[i]);
+    }
+
+    T minInput, maxInput, invStep;
+    T data[N + 3]{}; // data[1] = f(minInput), data[N + 1] = f(maxInput)
+
+private:
+    /* position of x in the table, as the index of the interval and the fraction into it */
+    template <typename V>
+    auto index(V x, V &frac) const noexcept
+    {
+        if constexpr (xsimd::is_batch<V>::value)
+        {
+            const auto pos = xsimd::max(V(T(0)), xsimd::min((x - V(minInput)) * V(invStep), V(T(N))));
+            const auto whole = xsimd::min(xsimd::floor(pos), V(T(N - 1)));
+            frac = pos - whole;
+            return xsimd::to_int(whole);
+        }
+        else
+        {
+            const auto pos = std::max(T(0), std::min((x - minInput) * invStep, T(N)));
+            const auto whole = std::min((size_t)pos, N - 1);
+            frac = pos - (T)whole;
+            return whole;
+        }
+    }
+
+    template <typename Index>
+    auto at(const Index &i, size_t offset) const noexcept
+    {
+        if constexpr (xsimd::is_batch<Index>::value)
+            return xsimd::batch<T, typename Index::arch_type>::gather(data + offset, i);
+        else
+            return data[i + offset];
+    }
+};
+
+/* Shared tables for common waveshapers, with helpers that handle their ranges */
+namespace lut
+{
+constexpr size_t defaultSize = 1024;
+
+/* Beyond +/-10, tanh is within 5e-9 of +/-1 */
+template <typename T, size_t N = defaultSize>
+inline const LookupTable<T, N> tanhTable{constexpr_math::tanh, -10.0, 10.0};
+
+/* atan over [-1, 1], larger inputs are folded into it by lut::atan() */
+template <typename T, size_t N = defaultSize>
+inline const LookupTable<T, N> atanTable{constexpr_math::atan, -1.0, 1.0};
+
+/* one period of sin, which lut::sin() & lut::cos() wrap into */
+template <typename T, size_t N = defaultSize>
+inline const LookupTable<T, N> sinTable{constexpr_math::sin, 0.0, 2.0 * constexpr_math::pi};
+
+template <Interpolation I = Interpolation::cubic, typename V>
+inline V tanh(V x) noexcept
+{
+    return tanhTable<fast_math::ScalarType<V>>.template process<I>(x);
+}
+
+template <Interpolation I = Interpolation::cubic, typename V>
+inline V atan(V x) noexcept
+{
+    using T = fast_math::ScalarType<V>;
+    const auto &table = atanTable<T>;
+
+    if constexpr (xsimd::is_batch<V>::value)
+    {
+        // atan(x) = sign(x) * pi/2 - atan(1/x) for |x| > 1
+        const auto outside = xsimd::abs(x) > V(T(1));
+        const auto inner = table.template process<I>(xsimd::select(outside, V(T(1)) / x, x));
+        const auto halfPi = xsimd::select(x < V(T(0)), V(T(-0.5 * constexpr_math::pi)), V(T(0.5 * constexpr_math::pi)));
+        return xsimd::select(outside, halfPi - inner, inner);
+    }
+    else
+    {
+        if (std::abs(x) <= T(1))
+            return table.template process<I>(x);
+
+        const auto halfPi = T(x < T(0) ? -0.5 * constexpr_math::pi : 0.5 * constexpr_math::pi);
+        return halfPi - table.template process<I>(T(1) / x);
+    }
+}
+
+template <Interpolation I = Interpolation::cubic, typename V>
+inline V sin(V x) noexcept
+{
+    using T = fast_math::ScalarType<V>;
+    constexpr auto twoPi = T(2.0 * constexpr_math::pi), invTwoPi = T(0.5 / constexpr_math::pi);
+
+    return sinTable<T>.template process<I>(x - V(twoPi) * fast_math::floor(x * V(invTwoPi)));
+}
+
+template <Interpolation I = Interpolation::cubic, typename V>
+inline V cos(V x) noexcept
+{
+    using T = fast_math::ScalarType<V>;
+    return lut::sin<I>(x + V(T(0.5 * constexpr_math::pi)));
+}
+}
@@ -0,0 +1,362 @@
+/**
+ * LoudnessMeter.h
+ * EBU R128 / ITU-R BS.1770-4 loudness: momentary, short-term & integrated LUFS, loudness
+ * range (EBU Tech 3342) and true peak
+*/
+#pragma once
+
+/**
+ * Runs entirely on the audio thread, and publishes its readings through atomics so a UI can
+ * poll them without locking.
+ *
+ * Audio is K-weighted with two IIRFilters per channel, and the weighted energy is summed into
+ * 100ms steps. Momentary (400ms) and short-term (3s) loudness are sliding sums of those steps.
+ * Gating blocks & short-term values go into histograms of 0.1 LU bins, which keep a count &
+ * an energy total per bin. So integrated loudness and loudness range are recomputed every
+ * 100ms from a fixed number of bins, however long the meter has been running. The relative
+ * gates are resolved to the bin, i.e. within 0.1 LU.
+ *
+ * True peak is the largest sample after 4x oversampling with the linear phase half-band FIRs
+ * in Oversampling.h.
+ */
+class LoudnessMeter
+{
+public:
+    /* reported for silence, and for integrated loudness/range before anything's passed the gates */
+    static constexpr float minusInfinity = -100.f;
+
+    void prepare(const dsp::ProcessSpec &spec)
+    {
+        sampleRate = spec.sampleRate;
+        numChannels = (size_t)spec.numChannels;
+        maxBlockSize = (size_t)spec.maximumBlockSize;
+        stepSize = jmax((size_t)1, (size_t)std::round(sampleRate * 0.1));
+
+        makeKWeighting();
+
+        preFilters.clear();
+        rlbFilters.clear();
+        for (size_t ch = 0; ch < numChannels; ++ch)
+        {
+            preFilters.emplace_back(preFilterCoeffs);
+            rlbFilters.emplace_back(rlbFilterCoeffs);
+        }
+
+        weights.resize(numChannels, 1.f);
+        kWeighted.setSize((int)numChannels, (int)maxBlockSize);
+
+        oversampler = std::make_unique<Oversampler<float>>(numChannels, 2, Oversampler<float>::FilterType::halfBandFIR);
+        oversampler->initProcessing(maxBlockSize);
+
+        reset();
+    }
+
+    /* Clears everything, including integrated loudness. Not safe during process(), use
+    resetIntegrated() from other threads */
+    void reset()
+    {
+        for (auto &f : preFilters)
+            f.reset();
+        for (auto &f : rlbFilters)
+            f.reset();
+        if (oversampler)
+            oversampler->reset();
+
+        stepEnergy = 0.0;
+        stepCount = 0;
+        steps.fill(0.0);
+        stepIndex = 0;
+        numSteps = 0;
+        truePeakValue = 0.f;
+
+        clearHistograms();
+
+        momentary = shortTerm = integrated = range = minusInfinity;
+        truePeak = 0.f;
+    }
+
+    /* Restarts integrated loudness, range & the true peak hold on the next process() call.
+    Safe to call from any thread */
+    void resetIntegrated() noexcept { resetRequested = true; }
+
+    /**
+     * Loudness weighting of a channel, BS.1770 uses 1 for L/R/C, 1.41 (+1.5dB) for the
+     * surrounds and 0 for the LFE. All channels default to 1.
+     * Call after prepare(), not during process()
+     */
+    void setChannelWeight(size_t channel, float weight)
+    {
+        jassert(channel < weights.size());
+        weights[channel] = weight;
+    }
+
+    void process(const float *const *channels, size_t numChannelsIn, size_t numSamples) noexcept
+    {
+        jassert(numChannelsIn == numChannels);
+        jassert(numSamples <= maxBlockSize);
+
+        if (resetRequested.exchange(false))
+        {
+            clearHistograms();
+            truePeakValue = 0.f;
+            integrated = range = minusInfinity;
+        }
+
+        measureTruePeak(channels, numSamples);
+
+        for (size_t offset = 0; offset < numSamples;)
+        {
+            const auto n = jmin(numSamples - offset, stepSize - stepCount);
+            stepEnergy += weightedEnergy(channels, offset, n);
+            stepCount += n;
+            offset += n;
+
+            if (stepCount == stepSize)
+                finishStep();
+        }
+    }
+
+    void process(const AudioBuffer<float> &buffer) noexcept
+    {
+        process(buffer.getArrayOfReadPointers(), (size_t)buffer.getNumChannels(), (size_t)buffer.getNumSamples());
+    }
+
+    /* LUFS over the last 400ms */
+    float getMomentaryLoudness() const noexcept { return momentary; }
+    /* LUFS over the last 3s */
+    float getShortTermLoudness() const noexcept { return shortTerm; }
+    /* gated LUFS since the last reset */
+    float getIntegratedLoudness() const noexcept { return integrated; }
+    /* LU between the 10th & 95th percentiles of gated short-term loudness since the last reset */
+    float getLoudnessRange() const noexcept { return range; }
+    /* largest inter-sample peak since the last reset, as gain */
+    float getTruePeak() const noexcept { return truePeak; }
+    float getTruePeakDecibels() const noexcept { return Decibels::gainToDecibels(truePeak.load(), minusInfinity); }
+
+private:
+    static constexpr size_t momentarySteps = 4, shortTermSteps = 30;
+    static constexpr float histogramMin = -70.f, binsPerLU = 10.f;
+    static constexpr size_t numBins = 800; // -70 to +10 LUFS
+
+    struct Histogram
+    {
+        std::array<uint64_t, numBins> counts{};
+        std::array<double, numBins> energies{};
+        uint64_t total = 0;
+        double totalEnergy = 0.0;
+
+        void clear()
+        {
+            counts.fill(0);
+            energies.fill(0.0);
+            total = 0;
+            totalEnergy = 0.0;
+        }
+
+        void add(double energy)
+        {
+            const auto bin = (size_t)jlimit(0.f, (float)(numBins - 1), (energyToLoudness(energy) - histogramMin) * binsPerLU);
+            ++counts[bin];
+            energies[bin] += energy;
+            ++total;
+            totalEnergy += energy;
+        }
+
+        /* first bin at or above a loudness */
+        static size_t binFor(double loudness)
+        {
+            return (size_t)jlimit(0.0, (double)numBins, std::ceil((loudness - histogramMin) * binsPerLU));
+        }
+
+        static float binCentre(size_t bin) { return histogramMin + ((float)bin + 0.5f) / binsPerLU; }
+    };
+
+    static float energyToLoudness(double energy)
+    {
+        return energy > 0.0 ? (float)(-0.691 + 10.0 * std::log10(energy)) : minusInfinity;
+    }
+
+    /* BS.1770 K-weighting, a high shelf for the head followed by the RLB highpass,
+    re-derived for the sample rate with the bilinear transform */
+    void makeKWeighting()
+    {
+        const auto pi = MathConstants<double>::pi;
+
+        {
+            const auto K = std::tan(pi * 1681.974450955533 / sampleRate);
+            const auto Q = 0.7071752369554196;
+            const auto Vh = std::pow(10.0, 3.999843853973347 / 20.0);
+            const auto Vb = std::pow(Vh, 0.4996667741545416);
+
+            preFilterCoeffs = new dsp::IIR::Coefficients<double>(Vh + Vb * K / Q + K * K, 2.0 * (K * K - Vh), Vh - Vb * K / Q + K * K,
+                                                                 1.0 + K / Q + K * K, 2.0 * (K * K - 1.0), 1.0 - K / Q + K * K);
+        }
+
+        {
+            const auto K = std::tan(pi * 38.13547087602444 / sampleRate);
+            const auto Q = 0.5003270373238773;
+            const auto a0 = 1.0 + K / Q + K * K;
+
+            // BS.1770's RLB numerator is {1, -2, 1} as is, but Coefficients divides everything
+            // by a0, so it's pre-multiplied here
+            rlbFilterCoeffs = new dsp::IIR::Coefficients<double>(a0, -2.0 * a0, a0,
+                                                                 a0, 2.0 * (K * K - 1.0), 1.0 - K / Q + K * K);
+        }
+    }
+
+    /* sum over channels of weight * sum of squares of the K-weighted signal */
+    double weightedEnergy(const float *const *channels, size_t offset, size_t numSamples) noexcept
+    {
+        double energy = 0.0;
+
+        for (size_t ch = 0; ch < numChannels; ++ch)
+        {
+            if (weights[ch] == 0.f)
+                continue;
+
+            auto *dest = kWeighted.getWritePointer((int)ch);
+            buffer_ops::copy(dest, channels[ch] + offset, numSamples);
+
+            auto block = AudioBlock<float>(kWeighted).getSingleChannelBlock(ch).getSubBlock(0, numSamples);
+            preFilters[ch].process(block);
+            rlbFilters[ch].process(block);
+
+            float peak, sumOfSquares;
+            buffer_ops::peakAndSumOfSquares(dest, numSamples, peak, sumOfSquares);
+            energy += (double)weights[ch] * (double)sumOfSquares;
+        }
+
+        return energy;
+    }
+
+    void measureTruePeak(const float *const *channels, size_t numSamples) noexcept
+    {
+        if (numSamples == 0)
+            return;
+
+        const auto up = oversampler->processSamplesUp(AudioBlock<const float>(channels, numChannels, numSamples));
+
+        for (size_t ch = 0; ch < numChannels; ++ch)
+            truePeakValue = jmax(truePeakValue, buffer_ops::maxAbs(up.getChannelPointer(ch), up.getNumSamples()));
+
+        truePeak = truePeakValue;
+    }
+
+    /* every 100ms: slide the momentary & short-term windows, and feed the gates */
+    void finishStep() noexcept
+    {
+        steps[stepIndex] = stepEnergy / (double)stepSize;
+        stepIndex = (stepIndex + 1) % shortTermSteps;
+        numSteps = jmin(numSteps + 1, shortTermSteps);
+        stepEnergy = 0.0;
+        stepCount = 0;
+
+        double momentaryEnergy = 0.0, shortTermEnergy = 0.0;
+        for (size_t i = 0; i < shortTermSteps; ++i)
+        {
+            const auto energy = steps[(stepIndex + shortTermSteps - 1 - i) % shortTermSteps];
+            shortTermEnergy += energy;
+            if (i < momentarySteps)
+                momentaryEnergy += energy;
+        }
+
+        momentaryEnergy /= (double)momentarySteps;
+        shortTermEnergy /= (double)shortTermSteps;
+
+        momentary = jmax(minusInfinity, energyToLoudness(momentaryEnergy));
+        shortTerm = jmax(minusInfinity, energyToLoudness(shortTermEnergy));
+
+        // gating blocks overlap by 75%, so one ends every step once the first 400ms are in
+        if (numSteps >= momentarySteps && energyToLoudness(momentaryEnergy) >= histogramMin)
+        {
+            blocks.add(momentaryEnergy);
+            integrated = gatedLoudness();
+        }
+
+        if (numSteps >= shortTermSteps && energyToLoudness(shortTermEnergy) >= histogramMin)
+        {
+            shortTermValues.add(shortTermEnergy);
+            range = loudnessRange();
+        }
+    }
+
+    /* mean energy of the blocks above the absolute gate, then of those within 10 LU of that */
+    float gatedLoudness() const noexcept
+    {
+        if (blocks.total == 0)
+            return minusInfinity;
+
+        const auto relativeGate = energyToLoudness(blocks.totalEnergy / (double)blocks.total) - 10.0;
+
+        uint64_t count = 0;
+        double energy = 0.0;
+        for (auto bin = Histogram::binFor(relativeGate); bin < numBins; ++bin)
+        {
+            count += blocks.counts[bin];
+            energy += blocks.energies[bin];
+        }
+
+        return count > 0 ? energyToLoudness(energy / (double)count) : minusInfinity;
+    }
+
+    /* EBU Tech 3342: spread between the 10th & 95th percentiles of the short-term values
+    within 20 LU of their mean */
+    float loudnessRange() const noexcept
+    {
+        const auto &h = shortTermValues;
+        if (h.total == 0)
+            return minusInfinity;
+
+        const auto firstBin = Histogram::binFor(energyToLoudness(h.totalEnergy / (double)h.total) - 20.0);
+
+        uint64_t count = 0;
+        for (auto bin = firstBin; bin < numBins; ++bin)
+            count += h.counts[bin];
+
+        if (count == 0)
+            return minusInfinity;
+
+        const auto percentile = [&](double fraction)
+        {
+            const auto target = (uint64_t)((double)(count - 1) * fraction);
+            uint64_t seen = 0;
+            for (auto bin = firstBin; bin < numBins; ++bin)
+            {
+                seen += h.counts[bin];
+                if (seen > target)
+                    return Histogram::binCentre(bin);
+            }
+            return Histogram::binCentre(numBins - 1);
+        };
+
+        return percentile(0.95) - percentile(0.1);
+    }
+
+    void clearHistograms()
+    {
+        blocks.clear();
+        shortTermValues.clear();
+    }
+
+    double sampleRate = 44100.0;
+    size_t numChannels = 0, maxBlockSize = 0, stepSize = 4410;
+
+    dsp::IIR::Coefficients<double>::Ptr preFilterCoeffs, rlbFilterCoeffs;
+    std::vector<IIRFilter<float>> preFilters, rlbFilters;
+    std::vector<float> weights;
+    DynamicBuffer<float> kWeighted;
+
+    std::unique_ptr<Oversampler<float>> oversampler;
+    float truePeakValue = 0.f;
+
+    double stepEnergy = 0.0;
+    size_t stepCount = 0;
+    std::array<double, shortTermSteps> steps{}; // mean energy of each of the last 30 steps
+    size_t stepIndex = 0, numSteps = 0;
+
+    Histogram blocks, shortTermValues;
+
+    std::atomic<float> momentary{minusInfinity}, shortTerm{minusInfinity}, integrated{minusInfinity},
+        range{minusInfinity}, truePeak{0.f};
+    std::atomic<bool> resetRequested{false};
+};
@@ -2,17 +2,69 @@
 
 #pragma once
 
-template <typename T, class RegBlock, class SIMDBlock>
-class SIMD
+namespace simd_transpose
 {
-    void interleaveSamples (const T** source, T* dest, int numSamples, int numChannels)
+    /** In-register transpose of an N x N block of samples, where N = b_type::size.
+        Before, rows[i] holds N consecutive samples of channel i; after, rows[j] holds
+        sample j of every channel. Done in log2(N) rounds of zip_lo/zip_hi shuffles,
+        which covers 2x2 & 4x4 doubles and 4x4 & 8x8 floats
+    */
+    template <typename b_type>
+    inline void transpose (b_type (&rows)[b_type::size]) noexcept
     {
+        constexpr auto N = b_type::size;
+        static_assert ((N & (N - 1)) == 0, "Register width must be a power of 2");
+
+        for (size_t round = 1; round < N; round <<= 1)
+        {
+            b_type tmp[N];
+
+            for (size_t i = 0; i < N / 2; ++i)
+            {
+                tmp[2 * i] = xsimd::zip_lo (rows[i], rows[i + N / 2]);
+                tmp[2 * i + 1] = xsimd::zip_hi (rows[i], rows[i + N / 2]);
+            }
+
+            for (size_t i = 0; i < N; ++i)
+                rows[i] = tmp[i];
+        }
+    }
+
+    /** Interleaves numChannels channels into dest, register-by-register when there are
+        exactly as many channels as lanes, with a scalar loop for everything else */
+    template <typename T>
+    inline void interleave (const T** source, T* dest, int numSamples, int numChannels) noexcept
+    {
+        int start = 0;
+
+        if constexpr (std::is_floating_point_v<T>)
+        {
+            using b_type = xsimd::batch<T>;
+            constexpr int N = (int) b_type::size;
+
+            if (numChannels == N)
+            {
+                for (; start + N <= numSamples; start += N)
+                {
+                    b_type rows[N];
+
+                    for (int ch = 0; ch < N; ++ch)
+                        rows[ch] = b_type::load_unaligned (source[ch] + start);
+
+                    transpose (rows);
+
+                    for (int j = 0; j < N; ++j)
+                        rows[j].store_unaligned (dest + (start + j) * N);
+                }
+            }
+        }
+
         for (int chan = 0; chan < numChannels; ++chan)
         {
-            auto i = chan;
+            auto i = chan + start * numChannels;
             const auto* src = source[chan];
 
-            for (int j = 0; j < numSamples; ++j)
+            for (int j = start; j < numSamples; ++j)
             {
                 dest[i] = src[j];
                 i += numChannels;
@@ -20,20 +72,71 @@ class SIMD
         }
     }
 
-    void deinterleaveSamples (const T* source, T** dest, int numSamples, int numChannels)
+    /** The inverse of interleave() */
+    template <typename T>
+    inline void deinterleave (const T* source, T** dest, int numSamples, int numChannels) noexcept
     {
+        int start = 0;
+
+        if constexpr (std::is_floating_point_v<T>)
+        {
+            using b_type = xsimd::batch<T>;
+            constexpr int N = (int) b_type::size;
+
+            if (numChannels == N)
+            {
+                for (; start + N <= numSamples; start += N)
+                {
+                    b_type rows[N];
+
+                    for (int j = 0; j < N; ++j)
+                        rows[j] = b_type::load_unaligned (source + (start + j) * N);
+
+                    transpose (rows);
+
+                    for (int ch = 0; ch < N; ++ch)
+                        rows[ch].store_unaligned (dest[ch] + start);
+                }
+            }
+        }
+
         for (int chan = 0; chan < numChannels; ++chan)
         {
-            auto i = chan;
+            auto i = chan + start * numChannels;
             auto* dst = dest[chan];
 
-            for (int j = 0; j < numSamples; ++j)
+            for (int j = start; j < numSamples; ++j)
             {
                 dst[j] = source[i];
                 i += numChannels;
             }
         }
     }
+}
+
+/** Interleaves a block of float or double channels into registers and back, e.g.
+    SIMD<double, AudioBlock<double>, AudioBlock<vec>> or
+    SIMD<float, AudioBlock<float>, AudioBlock<fvec>>.
+    The number of channels per register follows from xsimd::batch<T>::size,
+    so float blocks pack twice as many channels into each register as double blocks.
+*/
+template <typename T, class RegBlock, class SIMDBlock>
+class SIMD
+{
+    using b_type = xsimd::batch<T>;
+    static constexpr size_t regSize = b_type::size;
+
+    static_assert (std::is_floating_point_v<T>, "SIMD interleaves float or double channels");
+
+    void interleaveSamples (const T** source, T* dest, int numSamples, int numChannels)
+    {
+        simd_transpose::interleave (source, dest, numSamples, numChannels);
+    }
+
+    void deinterleaveSamples (const T* source, T** dest, int numSamples, int numChannels)
+    {
+        simd_transpose::deinterleave (source, dest, numSamples, numChannels);
+    }
 
     SIMDBlock interleaved;
     RegBlock zero;
@@ -48,13 +151,13 @@ public:
     // use the actual number of input channels, not num channels in a SIMD block
     void setInterleavedBlockSize(int numChannels, int numSamples)
     {
-        int numVecChannels = (numChannels + vec::size - 1) / vec::size;
+        int numVecChannels = (numChannels + (int) regSize - 1) / (int) regSize;
 
         interleaved = SIMDBlock(interleavedData, numVecChannels, numSamples);
-        zero = RegBlock(zeroData, vec::size, numSamples);
+        zero = RegBlock(zeroData, regSize, numSamples);
         zero.clear();
 
-        channelPointers.resize(numVecChannels * vec::size);
+        channelPointers.resize(numVecChannels * regSize);
     }
 
     SIMDBlock interleaveBlock(const RegBlock& block)
@@ -64,12 +167,12 @@ public:
         auto* inout = channelPointers.data();
 
         for (auto ch = 0; ch < numChannels; ch++)
-            inout[ch] = (ch < block.getNumChannels() ? const_cast<T*> (block.getChannelPointer (ch)) : zero.getChannelPointer (ch % vec::size));
+            inout[ch] = (ch < block.getNumChannels() ? const_cast<T*> (block.getChannelPointer (ch)) : zero.getChannelPointer (ch % regSize));
         
-        for (size_t ch = 0; ch < numChannels; ch += vec::size)
+        for (size_t ch = 0; ch < numChannels; ch += regSize)
         {
-            auto* simdBlockData = reinterpret_cast<T*> (interleaved.getChannelPointer (ch / vec::size));
-            interleaveSamples (&inout[ch], simdBlockData, static_cast<int> (n), static_cast<int> (vec::size));
+            auto* simdBlockData = reinterpret_cast<T*> (interleaved.getChannelPointer (ch / regSize));
+            interleaveSamples (&inout[ch], simdBlockData, static_cast<int> (n), static_cast<int> (regSize));
         }
 
         return interleaved.getSubBlock(0, block.getNumSamples());
@@ -81,13 +184,13 @@ public:
         auto numChannels = channelPointers.size();
         auto* inout = channelPointers.data();
 
-        for (size_t ch = 0; ch < numChannels; ch += vec::size)
+        for (size_t ch = 0; ch < numChannels; ch += regSize)
         {
-            auto* simdBlockData = reinterpret_cast<T*> (block.getChannelPointer (ch / vec::size));
+            auto* simdBlockData = reinterpret_cast<T*> (block.getChannelPointer (ch / regSize));
             deinterleaveSamples (simdBlockData,
                                 const_cast<T**> (&inout[ch]),
                                 static_cast<int> (n),
-                                static_cast<int> (vec::size));
+                                static_cast<int> (regSize));
         }
 
         // return inBlock;
@@ -115,6 +218,237 @@ namespace SampleTypeHelpers // Internal classes needed for handling sample type
     };
 }
 
+template <typename SampleType>
+class AudioBlock;
+
+/** Lazily evaluated element-wise expressions over AudioBlocks.
+
+    Chaining block operations like
+
+        block *= g; block += other; block.multiplyBy (smoother);
+
+    walks every channel three times. Building the same thing as an expression and
+    assigning it does a single vectorized pass per channel instead:
+
+        block.assign ((block.expr() * g + other.expr()) * smoother);
+
+    Expressions are built from block.expr(), scalars and SmoothedValues with +, - and *,
+    and nothing is computed until assign(). Smoothers are rendered into a small ramp
+    once per chunk of chunkSize samples and shared by every channel, so a smoother
+    advances exactly as it would with AudioBlock::multiplyBy(). Don't use the same
+    smoother twice in one expression, since it would be advanced twice.
+
+    Every block in an expression must have the sample type of the block it's assigned
+    to, and at least as many channels & samples.
+*/
+namespace block_expr
+{
+    /** Samples per pass over the channels, i.e. the length of a smoother's ramp */
+    constexpr size_t chunkSize = 256;
+
+    /** Base of every expression node, used to pick out the operators below */
+    struct Expression {};
+
+    template <typename T>
+    using EnableIfExpression = std::enable_if_t<std::is_base_of<Expression, T>::value, int>;
+
+    /* Nodes evaluate either `packed`, where V is xsimd::batch<SampleType> holding V::size
+       consecutive samples of a float/double block, or one sample at a time, where V is the
+       block's own SampleType (a float/double, or a register of an interleaved block) */
+
+    template <typename Sample>
+    struct Ref : Expression
+    {
+        using SampleType = Sample;
+        using NumericType = typename SampleTypeHelpers::ElementType<Sample>::Type;
+
+        explicit Ref (AudioBlock<const Sample> b) noexcept : block (b) {}
+
+        bool covers (size_t numChannels, size_t numSamples) const noexcept
+        {
+            return block.getNumChannels() >= numChannels && block.getNumSamples() >= numSamples;
+        }
+
+        void prepare (size_t) const noexcept {}
+        void bindChannel (size_t channel, size_t start) const noexcept { ptr = block.getChannelPointer (channel) + start; }
+
+        template <typename V, bool packed>
+        V eval (size_t i) const noexcept
+        {
+            if constexpr (packed)
+                return V::load_unaligned (ptr + i);
+            else
+                return ptr[i];
+        }
+
+        AudioBlock<const Sample> block;
+        mutable const Sample* ptr = nullptr;
+    };
+
+    template <typename Sample>
+    struct Constant : Expression
+    {
+        using SampleType = Sample;
+        using NumericType = typename SampleTypeHelpers::ElementType<Sample>::Type;
+
+        explicit Constant (NumericType v) noexcept : value (v) {}
+
+        bool covers (size_t, size_t) const noexcept { return true; }
+        void prepare (size_t) const noexcept {}
+        void bindChannel (size_t, size_t) const noexcept {}
+
+        template <typename V, bool>
+        V eval (size_t) const noexcept { return V (value); }
+
+        NumericType value;
+    };
+
+    template <typename Sample, typename Smoother>
+    struct Ramp : Expression
+    {
+        using SampleType = Sample;
+        using NumericType = typename SampleTypeHelpers::ElementType<Sample>::Type;
+
+        explicit Ramp (Smoother& s) noexcept : smoother (&s) {}
+
+        bool covers (size_t, size_t) const noexcept { return true; }
+
+        void prepare (size_t numSamples) const noexcept
+        {
+            if (! smoother->isSmoothing())
+            {
+                std::fill (ramp, ramp + numSamples, (NumericType) smoother->getTargetValue());
+                return;
+            }
+
+            for (size_t i = 0; i < numSamples; ++i)
+                ramp[i] = (NumericType) smoother->getNextValue();
+        }
+
+        void bindChannel (size_t, size_t) const noexcept {}
+
+        template <typename V, bool packed>
+        V eval (size_t i) const noexcept
+        {
+            if constexpr (packed)
+                return V::load_unaligned (ramp + i);
+            else
+                return V (ramp[i]);
+        }
+
+        Smoother* smoother;
+        mutable NumericType ramp[chunkSize];
+    };
+
+    struct Add      { template <typename V> static V apply (V a, V b) noexcept { return a + b; } };
+    struct Subtract { template <typename V> static V apply (V a, V b) noexcept { return a - b; } };
+    struct Multiply { template <typename V> static V apply (V a, V b) noexcept { return a * b; } };
+
+    template <typename Op, typename L, typename R>
+    struct Binary : Expression
+    {
+        static_assert (std::is_same<typename L::SampleType, typename R::SampleType>::value,
+                       "Both sides of an expression must have the same sample type");
+
+        using SampleType = typename L::SampleType;
+        using NumericType = typename L::NumericType;
+
+        Binary (const L& l, const R& r) noexcept : lhs (l), rhs (r) {}
+
+        bool covers (size_t numChannels, size_t numSamples) const noexcept
+        {
+            return lhs.covers (numChannels, numSamples) && rhs.covers (numChannels, numSamples);
+        }
+
+        void prepare (size_t numSamples) const noexcept
+        {
+            lhs.prepare (numSamples);
+            rhs.prepare (numSamples);
+        }
+
+        void bindChannel (size_t channel, size_t start) const noexcept
+        {
+            lhs.bindChannel (channel, start);
+            rhs.bindChannel (channel, start);
+        }
+
+        template <typename V, bool packed>
+        V eval (size_t i) const noexcept
+        {
+            return Op::apply (lhs.template eval<V, packed> (i), rhs.template eval<V, packed> (i));
+        }
+
+        L lhs;
+        R rhs;
+    };
+
+   #define STRIX_BLOCK_EXPR_OPERATOR(symbol, Op) \
+    template <typename L, typename R, EnableIfExpression<L> = 0, EnableIfExpression<R> = 0> \
+    Binary<Op, L, R> operator symbol (const L& l, const R& r) noexcept { return { l, r }; } \
+    template <typename L, EnableIfExpression<L> = 0> \
+    Binary<Op, L, Constant<typename L::SampleType>> operator symbol (const L& l, typename L::NumericType r) noexcept { return { l, Constant<typename L::SampleType> (r) }; } \
+    template <typename R, EnableIfExpression<R> = 0> \
+    Binary<Op, Constant<typename R::SampleType>, R> operator symbol (typename R::NumericType l, const R& r) noexcept { return { Constant<typename R::SampleType> (l), r }; }
+
+    STRIX_BLOCK_EXPR_OPERATOR (+, Add)
+    STRIX_BLOCK_EXPR_OPERATOR (-, Subtract)
+    STRIX_BLOCK_EXPR_OPERATOR (*, Multiply)
+
+   #undef STRIX_BLOCK_EXPR_OPERATOR
+
+    /** Scales an expression by a smoothed value, one step of the smoother per sample */
+    template <typename L, typename T, typename SmoothingType, EnableIfExpression<L> = 0>
+    auto operator* (const L& l, SmoothedValue<T, SmoothingType>& smoother) noexcept
+    {
+        return Binary<Multiply, L, Ramp<typename L::SampleType, SmoothedValue<T, SmoothingType>>> (l, Ramp<typename L::SampleType, SmoothedValue<T, SmoothingType>> (smoother));
+    }
+
+    template <typename R, typename T, typename SmoothingType, EnableIfExpression<R> = 0>
+    auto operator* (SmoothedValue<T, SmoothingType>& smoother, const R& r) noexcept
+    {
+        return r * smoother;
+    }
+
+    /** Evaluates an expression into dest, one chunk at a time, one pass per channel */
+    template <typename SampleType, typename Expr>
+    void evaluate (const AudioBlock<SampleType>& dest, const Expr& expression) noexcept
+    {
+        using Sample = std::remove_const_t<SampleType>;
+        static_assert (! std::is_const<SampleType>::value, "Can't assign to a block of const samples");
+        static_assert (std::is_same<Sample, typename Expr::SampleType>::value,
+                       "The expression must have the same sample type as the block it's assigned to");
+
+        const auto numChannels = dest.getNumChannels();
+        const auto numSamples = dest.getNumSamples();
+
+        jassert (expression.covers (numChannels, numSamples));
+
+        for (size_t start = 0; start < numSamples; start += chunkSize)
+        {
+            const auto n = jmin (chunkSize, numSamples - start);
+            expression.prepare (n);
+
+            for (size_t ch = 0; ch < numChannels; ++ch)
+            {
+                expression.bindChannel (ch, start);
+                auto* out = dest.getChannelPointer (ch) + start;
+                size_t i = 0;
+
+                if constexpr (std::is_floating_point<Sample>::value)
+                {
+                    using b_type = xsimd::batch<Sample>;
+
+                    for (; i + b_type::size <= n; i += b_type::size)
+                        expression.template eval<b_type, true> (i).store_unaligned (out + i);
+                }
+
+                for (; i < n; ++i)
+                    out[i] = expression.template eval<Sample, false> (i);
+            }
+        }
+    }
+}
+
 //==============================================================================
 /**
     Minimal and lightweight data-structure which contains a list of pointers to
@@ -212,7 +546,8 @@ public:
         Therefore it is the user's responsibility to ensure that the buffer is retained
         throughout the life-time of the AudioBlock without being modified.
     */
-    constexpr AudioBlock (strix::Buffer<SampleType>& buffer) noexcept
+    template <size_t MaxChannels>
+    constexpr AudioBlock (strix::Buffer<SampleType, MaxChannels>& buffer) noexcept
         : channels (buffer.getArrayOfWritePointers()),
           numChannels (static_cast<ChannelCountType> (buffer.getNumChannels())),
           numSamples (static_cast<size_t> (buffer.getNumSamples()))
@@ -224,7 +559,8 @@ public:
         Therefore it is the user's responsibility to ensure that the buffer is retained
         throughout the life-time of the AudioBlock without being modified.
     */
-    AudioBlock (strix::Buffer<SampleType>& buffer, size_t startSampleIndex) noexcept
+    template <size_t MaxChannels>
+    AudioBlock (strix::Buffer<SampleType, MaxChannels>& buffer, size_t startSampleIndex) noexcept
         : channels (buffer.getArrayOfWritePointers()),
           numChannels (static_cast<ChannelCountType> (buffer.getNumChannels())),
           startSample (startSampleIndex),
@@ -375,12 +711,12 @@ public:
         SIMDRegister then incrementing srcPos by one will increase the sample position
         in the Buffer's units by a factor of SIMDRegister<SampleType>::SIMDNumElements.
     */
-    template <typename OtherNumericType>
-    AudioBlock&       copyFrom (const Buffer<OtherNumericType>& src,
+    template <typename OtherNumericType, size_t MaxChannels>
+    AudioBlock&       copyFrom (const Buffer<OtherNumericType, MaxChannels>& src,
                                 size_t srcPos = 0, size_t dstPos = 0,
                                 size_t numElements = std::numeric_limits<size_t>::max())         { copyFromInternal (src, srcPos, dstPos, numElements); return *this; }
-    template <typename OtherNumericType>
-    const AudioBlock& copyFrom (const Buffer<OtherNumericType>& src,
+    template <typename OtherNumericType, size_t MaxChannels>
+    const AudioBlock& copyFrom (const Buffer<OtherNumericType, MaxChannels>& src,
                                 size_t srcPos = 0, size_t dstPos = 0,
                                 size_t numElements = std::numeric_limits<size_t>::max()) const   { copyFromInternal (src, srcPos, dstPos, numElements); return *this; }
 
@@ -391,7 +727,8 @@ public:
         SIMDRegister then incrementing dstPos by one will increase the sample position
         in the Buffer's units by a factor of SIMDRegister<SampleType>::SIMDNumElements.
     */
-    void copyTo (Buffer<typename std::remove_const<NumericType>::type>& dst, size_t srcPos = 0, size_t dstPos = 0,
+    template <size_t MaxChannels>
+    void copyTo (Buffer<typename std::remove_const<NumericType>::type, MaxChannels>& dst, size_t srcPos = 0, size_t dstPos = 0,
                  size_t numElements = std::numeric_limits<size_t>::max()) const
     {
         auto dstlen = static_cast<size_t> (dst.getNumSamples()) / sizeFactor;
@@ -570,6 +907,18 @@ public:
     template <typename Src1SampleType, typename Src2SampleType>
     const AudioBlock& replaceWithMaxOf (AudioBlock<Src1SampleType> src1, AudioBlock<Src2SampleType> src2) const noexcept   { replaceWithMaxOfInternal (src1, src2); return *this; }
 
+    //==============================================================================
+    /** Returns this block as the leaf of a lazily evaluated expression, see block_expr. */
+    block_expr::Ref<std::remove_const_t<SampleType>> expr() const noexcept   { return block_expr::Ref<std::remove_const_t<SampleType>> (*this); }
+
+    /** Evaluates an expression built from expr(), scalars and smoothed values into this
+        block, in a single pass over each channel.
+    */
+    template <typename Expression, block_expr::EnableIfExpression<Expression> = 0>
+    AudioBlock&       assign (const Expression& expression)       noexcept   { block_expr::evaluate (*this, expression); return *this; }
+    template <typename Expression, block_expr::EnableIfExpression<Expression> = 0>
+    const AudioBlock& assign (const Expression& expression) const noexcept   { block_expr::evaluate (*this, expression); return *this; }
+
     //==============================================================================
     /** Finds the minimum and maximum value of the buffer. */
     Range<typename std::remove_const<NumericType>::type> findMinAndMax() const noexcept
@@ -678,8 +1027,8 @@ private:
             FloatVectorOperations::copy (getDataPointer (ch), src.getDataPointer (ch), n);
     }
 
-    template <typename OtherNumericType>
-    void copyFromInternal (const Buffer<OtherNumericType>& src, size_t srcPos, size_t dstPos, size_t numElements) const
+    template <typename OtherNumericType, size_t MaxChannels>
+    void copyFromInternal (const Buffer<OtherNumericType, MaxChannels>& src, size_t srcPos, size_t dstPos, size_t numElements) const
     {
         auto srclen = static_cast<size_t> (src.getNumSamples()) / sizeFactor;
         auto n = jmin (srclen - srcPos, numSamples - dstPos, numElements) * sizeFactor;
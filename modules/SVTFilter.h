@@ -17,15 +17,18 @@ class SVTFilter
     SmoothedValue<float> sm_reso;
     SmoothedValue<float, ValueSmoothingTypes::Multiplicative> sm_freq;
 
+    using NumericType = buffer_ops::NumericType<T>;
+
     void update()
     {
-        if constexpr (std::is_same<T, double>::value)
-            g = (double)(std::tan(MathConstants<double>::pi * cutoffFrequency / sampleRate));
-        else
-            g = (T)(xsimd::tan((T)MathConstants<double>::pi * cutoffFrequency / (T)sampleRate));
-
-        R2 = (T)(1.0 / resonance);
-        h = (T)(1.0 / (1.0 + R2 * g + g * g));
+        // the coefficients are the same in every lane, so work them out as scalars
+        // and broadcast them, in whichever precision T uses
+        const auto wc = std::tan(MathConstants<double>::pi * cutoffFrequency / sampleRate);
+        const auto r2 = 1.0 / resonance;
+
+        g = (T)(NumericType)wc;
+        R2 = (T)(NumericType)r2;
+        h = (T)(NumericType)(1.0 / (1.0 + r2 * wc + wc * wc));
     }
 
     FilterType type = FilterType::lowpass;
@@ -81,8 +84,8 @@ public:
 
     void reset()
     {
-        std::fill(s1.begin(), s1.end(), 0.0);
-        std::fill(s2.begin(), s2.end(), 0.0);
+        std::fill(s1.begin(), s1.end(), T(0.0));
+        std::fill(s2.begin(), s2.end(), T(0.0));
     }
 
     void prepare(const dsp::ProcessSpec &spec)
@@ -102,6 +105,40 @@ public:
         update();
     }
 
+    /* true once every channel's state has decayed below silence::threshold */
+    bool isStateSilent() const
+    {
+        for (size_t ch = 0; ch < s1.size(); ++ch)
+            if (!silence::isBelow(s1[ch]) || !silence::isBelow(s2[ch]))
+                return false;
+
+        return true;
+    }
+
+    /// @brief processBlock() that skips the filter when it has nothing left to do
+    /// @param inputIsSilent whether the block is known to be all zeroes (see Buffer::isSilent()).
+    /// If so, and the state has decayed, the block is left untouched
+    template <class Block>
+    void processBlock(Block &block, bool inputIsSilent)
+    {
+        if (inputIsSilent && isStateSilent())
+        {
+            if constexpr (useSmoother)
+            {
+                if (sm_freq.isSmoothing() || sm_reso.isSmoothing())
+                {
+                    cutoffFrequency = sm_freq.skip((int)block.getNumSamples());
+                    resonance = sm_reso.skip((int)block.getNumSamples());
+                    update();
+                }
+            }
+            reset();
+            return;
+        }
+
+        processBlock(block);
+    }
+
     template <class Block>
     void processBlock(Block &block)
     {
@@ -156,6 +193,17 @@ public:
         }
     }
 
+    void processChannel(T *in, size_t ch, size_t numSamples, bool inputIsSilent)
+    {
+        if (inputIsSilent && silence::isBelow(s1[ch]) && silence::isBelow(s2[ch]))
+        {
+            s1[ch] = s2[ch] = T(0.0);
+            return;
+        }
+
+        processChannel(in, ch, numSamples);
+    }
+
     inline T processSample(size_t channel, T in)
     {
         assert(s1.size() > channel && s1.size() > 0);
@@ -4,13 +4,143 @@
 #include <stddef.h>
 
 // A modern type of data buffer.
+// Non-owning view of len elements spaced stride elements apart, so one Slice type
+// covers raw arrays, Buffer & AudioBlock channels and single channels of interleaved data.
+// Like AudioBlock, it's up to you to keep the underlying memory alive.
 
 template <typename T>
 struct Slice {
-	T *data;
-	size_t len;
+	T *data = nullptr;
+	size_t len = 0;
+	size_t stride = 1;
 
 	Slice() = default;
 
 	Slice(T type[], size_t size) : data(type), len(size) {}
+
+	Slice(T *ptr, size_t size, size_t step) : data(ptr), len(size), stride(step) {}
+
+	/* view of one channel in a Buffer */
+	template <size_t MaxChannels, typename U = T, std::enable_if_t<!std::is_const_v<U>, int> = 0>
+	Slice(Buffer<U, MaxChannels> &buffer, int channel)
+		: data(buffer.getWritePointer(channel)), len((size_t)buffer.getNumSamples()) {}
+
+	template <size_t MaxChannels, typename U = T, std::enable_if_t<std::is_const_v<U>, int> = 0>
+	Slice(const Buffer<std::remove_const_t<U>, MaxChannels> &buffer, int channel)
+		: data(buffer.getReadPointer(channel)), len((size_t)buffer.getNumSamples()) {}
+
+	/* view of one channel in an AudioBlock */
+	template <typename BlockType>
+	Slice(const AudioBlock<BlockType> &block, size_t channel)
+		: data(block.getChannelPointer(channel)), len(block.getNumSamples()) {}
+
+	/* view of one channel of interleaved data, i.e. LRLRLR... */
+	static Slice interleaved(T *interleavedData, size_t numFrames, size_t numChannels, size_t channel)
+	{
+		jassert(channel < numChannels);
+		return { interleavedData + channel, numFrames, numChannels };
+	}
+
+	template <typename U = T, std::enable_if_t<!std::is_const_v<U>, int> = 0>
+	operator Slice<const U>() const { return { data, len, stride }; }
+
+	size_t size() const { return len; }
+	bool empty() const { return len == 0; }
+	bool isContiguous() const { return stride == 1; }
+
+	T &operator[](size_t i) const
+	{
+		jassert(i < len);
+		return data[i * stride];
+	}
+
+	/* elements [offset, offset + length) of this slice */
+	Slice sub(size_t offset, size_t length) const
+	{
+		jassert(offset + length <= len);
+		return { data + offset * stride, length, stride };
+	}
+
+	Slice sub(size_t offset) const { return sub(offset, len - offset); }
+
+	/* every step-th element of this slice, starting with the first */
+	Slice strided(size_t step) const
+	{
+		jassert(step > 0);
+		return { data, (len + step - 1) / step, stride * step };
+	}
+
+	struct Iterator
+	{
+		T *ptr;
+		size_t stride;
+
+		T &operator*() const { return *ptr; }
+		Iterator &operator++() { ptr += stride; return *this; }
+		bool operator!=(const Iterator &other) const { return ptr != other.ptr; }
+	};
+
+	Iterator begin() const { return { data, stride }; }
+	Iterator end() const { return { data + len * stride, stride }; }
+
+	void fill(std::remove_const_t<T> value) const
+	{
+		if (isContiguous())
+			std::fill(data, data + len, value);
+		else
+			for (auto &x : *this)
+				x = value;
+	}
+
+	/* copies min(len, source.len) elements, converting the sample type if needed */
+	template <typename U>
+	void copyFrom(Slice<U> source) const
+	{
+		const auto n = jmin(len, source.len);
+
+		if (isContiguous() && source.isContiguous())
+			buffer_ops::copy(data, source.data, n);
+		else
+			for (size_t i = 0; i < n; ++i)
+				(*this)[i] = static_cast<std::remove_const_t<T>>(source[i]);
+	}
+
+	/* A contiguous float/double slice split into an unaligned head, a body of whole,
+	aligned xsimd registers, and a tail of what's left over */
+	template <typename Batch>
+	struct SIMDSplit
+	{
+		Slice head;
+		Slice<Batch> body;
+		Slice tail;
+	};
+
+	/* Splits the slice so the body can be processed with aligned xsimd loads/stores
+	(or as an array of registers), leaving the head & tail for a scalar loop */
+	auto splitAligned() const
+	{
+		using Numeric = std::remove_const_t<T>;
+		static_assert(std::is_floating_point_v<Numeric>, "Only float/double slices can be split into registers");
+		using b_type = xsimd::batch<Numeric>;
+		using Batch = std::conditional_t<std::is_const_v<T>, const b_type, b_type>;
+		constexpr auto alignment = b_type::arch_type::alignment();
+
+		jassert(isContiguous());
+
+		const auto misalignment = reinterpret_cast<uintptr_t>(data) % alignment;
+		auto headLen = misalignment == 0 ? 0 : (alignment - misalignment) / sizeof(Numeric);
+
+		// data that isn't even aligned to its own element size can't ever line up
+		if (misalignment % sizeof(Numeric) != 0 || headLen > len)
+			headLen = len;
+
+		const auto numBatches = (len - headLen) / b_type::size;
+		const auto bodyLen = numBatches * b_type::size;
+
+		SIMDSplit<Batch> split;
+		split.head = sub(0, headLen);
+		split.body = Slice<Batch>(reinterpret_cast<Batch *>(data + headLen), numBatches);
+		split.tail = sub(headLen + bodyLen);
+		return split;
+	}
 };
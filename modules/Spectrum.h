@@ -0,0 +1,261 @@
+/**
+ * Spectrum.h
+ * FFT spectrum analyzer source, with the analysis done on its own thread
+*/
+#pragma once
+
+/**
+ * Fed from the audio thread like VolumeMeterSource::copyBuffer(), which only copies samples
+ * into a FIFO. A background thread reads them back in overlapping hops, averages the
+ * channels, Hann-windows & FFTs each frame, and applies fractional-octave smoothing & peak
+ * hold.
+ *
+ * Finished frames are published through a triple buffer. The analysis thread always has a
+ * frame of its own to write into, so getFrame() on the GUI thread just swaps indices & never
+ * waits on anything.
+ *
+ * The frames are allocated once, for the largest FFT the constructor allows, and each one
+ * carries its own bin count & width. So prepare() can change the FFT size while the GUI is
+ * reading: it only touches the analysis thread's own frame, and a frame published before it
+ * stays valid for the settings it was made with.
+ */
+class SpectrumSource : private Thread
+{
+public:
+    struct Frame
+    {
+        std::vector<float> magnitudes; // dBFS of a full scale sine, per bin
+        std::vector<float> peaks;      // peak hold of magnitudes
+        size_t numBins = 0;            // valid entries in magnitudes & peaks
+        double binWidth = 0.0;         // Hz
+        uint32_t frameNumber = 0;
+
+        float getBinFrequency(size_t bin) const noexcept { return (float)((double)bin * binWidth); }
+    };
+
+    static constexpr float minusInfinity = -120.f;
+
+    /* @param maxFFTOrder the largest fftOrder prepare() will be called with */
+    explicit SpectrumSource(int maxFFTOrder = 14) : Thread("SpectrumSource"), maxOrder(maxFFTOrder)
+    {
+        const auto maxBins = ((size_t)1 << maxOrder) / 2 + 1;
+        for (auto &f : frames)
+        {
+            f.magnitudes.assign(maxBins, minusInfinity);
+            f.peaks.assign(maxBins, minusInfinity);
+        }
+    }
+
+    ~SpectrumSource() override { stopThread(1000); }
+
+    /**
+     * @param fftOrder log2 of the FFT size, up to the constructor's maxFFTOrder
+     * @param overlap frames per FFT length, i.e. the hop is fftSize / overlap
+     *
+     * Safe while the GUI calls getFrame(), not during copyBuffer()
+     */
+    void prepare(const dsp::ProcessSpec &spec, int fftOrder = 12, int overlap = 4)
+    {
+        jassert(fftOrder > 0 && fftOrder <= maxOrder && overlap > 0);
+        fftOrder = jlimit(1, maxOrder, fftOrder);
+        stopThread(1000);
+
+        sampleRate = spec.sampleRate;
+        numChannels = jmax((size_t)1, (size_t)spec.numChannels);
+        fftSize = (size_t)1 << fftOrder;
+        hopSize = jmax((size_t)1, fftSize / (size_t)overlap);
+        numBins = fftSize / 2 + 1;
+
+        fft = std::make_unique<dsp::FFT>(fftOrder);
+        window.resize(fftSize);
+        dsp::WindowingFunction<float>::fillWindowingTables(window.data(), fftSize, dsp::WindowingFunction<float>::hann, false);
+        // scales a full scale sine to 0dB
+        magnitudeScale = 2.f / std::accumulate(window.begin(), window.end(), 0.f);
+
+        // ~0.5s of audio, or at least a couple of frames
+        const auto fifoSize = jmax(2 * fftSize, (size_t)(sampleRate * 0.5), (size_t)spec.maximumBlockSize * 2);
+        samples.setSize((int)numChannels, (int)fifoSize);
+        fifo.setTotalSize((int)fifoSize);
+
+        history.assign(fftSize, 0.f);
+        hop.assign(hopSize, 0.f);
+        fftData.assign(fftSize * 2, 0.f);
+        powers.assign(numBins, 0.f);
+        prefixSums.assign(numBins + 1, 0.0);
+
+        // front & middle may be in the reader's hands, so only the analysis thread's frame is
+        // reset, and the peak hold starts again from it
+        auto &frame = frames[back];
+        std::fill(frame.peaks.begin(), frame.peaks.end(), minusInfinity);
+        lastWritten = back;
+
+        startThread(Thread::Priority::low);
+    }
+
+    // lock-free method for copying data to the analyzer, only ever a memcpy of this block
+    template <typename T>
+    void copyBuffer(const T *const *buffer, size_t numBufferChannels, size_t numSamples)
+    {
+        const auto scope = fifo.write(jmin((int)numSamples, fifo.getFreeSpace()));
+        const auto numToCopy = jmin(numBufferChannels, numChannels);
+
+        for (size_t ch = 0; ch < numToCopy; ++ch)
+        {
+            if (scope.blockSize1 > 0)
+                buffer_ops::copy(samples.getWritePointer((int)ch, scope.startIndex1), buffer[ch], (size_t)scope.blockSize1);
+            if (scope.blockSize2 > 0)
+                buffer_ops::copy(samples.getWritePointer((int)ch, scope.startIndex2), buffer[ch] + scope.blockSize1, (size_t)scope.blockSize2);
+        }
+
+        numInputChannels = numToCopy;
+    }
+
+    void copyBuffer(const AudioBuffer<float> &buffer)
+    {
+        copyBuffer(buffer.getArrayOfReadPointers(), (size_t)buffer.getNumChannels(), (size_t)buffer.getNumSamples());
+    }
+
+    /* 1/3 for third-octave smoothing etc., 0 for none */
+    void setSmoothing(float octaveFraction) { smoothing = jmax(0.f, octaveFraction); }
+
+    /* how fast the peak hold falls back, in dB per second */
+    void setPeakDecay(float decibelsPerSecond) { peakDecay = jmax(0.f, decibelsPerSecond); }
+
+    /**
+     * The newest frame. The reference stays valid until the next call, so draw from it
+     * straight away. One reader only, e.g. the GUI thread
+     */
+    const Frame &getFrame() noexcept
+    {
+        if (middle.load(std::memory_order_relaxed) & newFrameFlag)
+            front = middle.exchange(front, std::memory_order_acq_rel) & indexMask;
+
+        return frames[front];
+    }
+
+private:
+    static constexpr int indexMask = 3, newFrameFlag = 4;
+
+    void run() override
+    {
+        const auto hopMs = jmax(1, (int)(500.0 * (double)hopSize / sampleRate));
+
+        while (!threadShouldExit())
+        {
+            if (fifo.getNumReady() < (int)hopSize)
+            {
+                wait(hopMs);
+                continue;
+            }
+
+            readHop();
+            analyse();
+        }
+    }
+
+    /* takes the next hop from the FIFO, mixed down to mono, and slides it into the history */
+    void readHop()
+    {
+        const auto scope = fifo.read((int)hopSize);
+        const auto numMixed = jmax((size_t)1, jmin(numInputChannels.load(), numChannels));
+        const auto gain = 1.f / (float)numMixed;
+
+        std::fill(hop.begin(), hop.end(), 0.f);
+        for (size_t ch = 0; ch < numMixed; ++ch)
+        {
+            if (scope.blockSize1 > 0)
+                buffer_ops::addWithGain(hop.data(), samples.getReadPointer((int)ch) + scope.startIndex1, gain, (size_t)scope.blockSize1);
+            if (scope.blockSize2 > 0)
+                buffer_ops::addWithGain(hop.data() + scope.blockSize1, samples.getReadPointer((int)ch) + scope.startIndex2, gain, (size_t)scope.blockSize2);
+        }
+
+        std::move(history.begin() + (ptrdiff_t)hopSize, history.end(), history.begin());
+        std::copy(hop.begin(), hop.end(), history.end() - (ptrdiff_t)hopSize);
+    }
+
+    void analyse()
+    {
+        std::copy(history.begin(), history.end(), fftData.begin());
+        buffer_ops::multiply(fftData.data(), window.data(), fftSize);
+        fft->performFrequencyOnlyForwardTransform(fftData.data(), true);
+
+        for (size_t i = 0; i < numBins; ++i)
+        {
+            const auto m = fftData[i] * magnitudeScale;
+            powers[i] = m * m;
+        }
+
+        auto &frame = frames[back];
+        frame.numBins = numBins;
+        frame.binWidth = sampleRate / (double)fftSize;
+        smooth(frame.magnitudes);
+
+        // decay from the last published frame's peaks, which this thread wrote. Bins past the
+        // end of a frame from before prepare() were left at minusInfinity
+        const auto &previous = frames[lastWritten];
+        const auto decay = peakDecay.load() * (float)((double)hopSize / sampleRate);
+        for (size_t i = 0; i < numBins; ++i)
+            frame.peaks[i] = jmax(frame.magnitudes[i], previous.peaks[i] - decay);
+
+        frame.frameNumber = ++frameCount;
+        lastWritten = back;
+        back = middle.exchange(back | newFrameFlag, std::memory_order_acq_rel) & indexMask;
+    }
+
+    /* Power averaged over +/- half the smoothing width around each bin, from prefix sums so it
+    costs the same whatever the width, then converted to dB */
+    void smooth(std::vector<float> &dest)
+    {
+        const auto fraction = smoothing.load();
+
+        if (fraction <= 0.f)
+        {
+            for (size_t i = 0; i < numBins; ++i)
+                dest[i] = powerToDecibels(powers[i]);
+            return;
+        }
+
+        for (size_t i = 0; i < numBins; ++i)
+            prefixSums[i + 1] = prefixSums[i] + (double)powers[i];
+
+        const auto ratio = std::pow(2.0, 0.5 * (double)fraction);
+
+        for (size_t i = 0; i < numBins; ++i)
+        {
+            const auto lo = jmin(i, (size_t)((double)i / ratio));
+            const auto hi = jlimit(i + 1, numBins, (size_t)std::ceil((double)i * ratio) + 1);
+            dest[i] = powerToDecibels((float)((prefixSums[hi] - prefixSums[lo]) / (double)(hi - lo)));
+        }
+    }
+
+    static float powerToDecibels(float power)
+    {
+        return power > 0.f ? jmax(minusInfinity, 10.f * std::log10(power)) : minusInfinity;
+    }
+
+    const int maxOrder;
+    double sampleRate = 44100.0;
+    size_t numChannels = 1, fftSize = 4096, hopSize = 1024, numBins = 2049;
+
+    /* audio thread -> analysis thread */
+    AbstractFifo fifo{1024};
+    DynamicBuffer<float> samples;
+    std::atomic<size_t> numInputChannels = 0;
+
+    /* analysis thread */
+    std::unique_ptr<dsp::FFT> fft;
+    std::vector<float> window, history, hop, fftData, powers;
+    std::vector<double> prefixSums;
+    float magnitudeScale = 1.f;
+    uint32_t frameCount = 0;
+    int back = 0, lastWritten = 0;
+
+    std::atomic<float> smoothing{1.f / 3.f}, peakDecay{20.f};
+
+    /* triple buffer: the analysis thread owns frames[back], the reader owns frames[front],
+    and middle holds the other index, flagged when it's a frame the reader hasn't seen.
+    Only the constructor sizes the frames */
+    std::array<Frame, 3> frames;
+    std::atomic<int> middle{1};
+    int front = 2;
+};
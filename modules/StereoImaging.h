@@ -203,7 +203,7 @@ struct GruhnStereoEnhancer
         {
             T s0 = left[i] >= 0 ? 1.f : -1.f;
             T s1 = right[i] >= 0 ? 1.f : -1.f;
-            auto angle = std::atan( left[i] / right[i] );
+            auto angle = lut::atan( left[i] / right[i] );
             if((s0 == 1 && s1 == -1) || (s0 == -1 && s1 == -1)) angle += 3.141592654f;
             if(s0 == -1 && s1 == 1) angle += 6.283185307f;
             if(right[i] == 0) {
@@ -220,8 +220,8 @@ struct GruhnStereoEnhancer
             }
             angle -= rot;
             auto radius = std::sqrt( (left[i]*left[i]) + (right[i]*right[i]) );
-            left[i] = sin(angle)*radius;
-            right[i] = cos(angle)*radius;
+            left[i] = lut::sin(angle)*radius;
+            right[i] = lut::cos(angle)*radius;
         }
     }
 };
\ No newline at end of file
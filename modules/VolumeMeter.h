@@ -2,41 +2,72 @@
 #pragma once
 #include <JuceHeader.h>
 
-struct VolumeMeterSource : Timer
+/**
+ * Measures peak & windowed RMS for any number of channels (at least 2, a mono source shows
+ * up on both), so a whole surround or ambisonic bus can share one source & timer.
+ * Per-channel state is kept as one array per quantity, so updating it per block is a
+ * straight loop over channels.
+ *
+ * Measuring happens on the message thread, driven by the MeterRefreshHub while a meter
+ * attached to the source is on screen.
+ */
+struct VolumeMeterSource
 {
-    VolumeMeterSource()
+    enum class Mode
     {
-        startTimerHz(60);
-    }
-
-    ~VolumeMeterSource() override { stopTimer(); }
+        copySamples, // audio is copied to the meter & measured on the timer
+        audioThread  // copyBuffer() measures each block itself & only hands over its levels
+    };
 
     /**
      * @param rmsWindow window in sec to measure RMS
+     * @param mode in Mode::audioThread, the sample buffers aren't allocated and nothing is locked
+     * on the audio thread
+     *
+     * Holds the meter's lock, which measure() & the getters also take, since the per-channel
+     * storage they read may be reallocated here. Not safe during copyBuffer()
      */
-    void prepare(const dsp::ProcessSpec &spec, const float rmsWindow)
+    void prepare(const dsp::ProcessSpec &spec, const float rmsWindow, Mode meterMode = Mode::copySamples)
     {
-        numSamplesToRead = spec.maximumBlockSize;
-        mainBuf.setSize(spec.numChannels, jmax(44100, (int)spec.maximumBlockSize), false, true, false);
-        rmsBuf.setSize(spec.numChannels, numSamplesToRead, false, true, false);
-        fifo.setTotalSize(numSamplesToRead);
+        const juce::ScopedLock lock(mutex);
 
-        rmsSize = (rmsWindow * spec.sampleRate) / (float)spec.maximumBlockSize;
-        rmsvec[0].assign((size_t)rmsSize, 0.f);
-        rmsvec[1].assign((size_t)rmsSize, 0.f);
-
-        sum[0] = sum[1] = 0.f;
+        mode = meterMode;
+        numSamplesToRead = spec.maximumBlockSize;
+        numChannels = jmax((size_t)2, (size_t)spec.numChannels);
 
-        if (rmsSize > 1)
+        if (mode == Mode::copySamples)
         {
-            lPtr %= rmsvec[0].size();
-            rPtr %= rmsvec[1].size();
+            mainBuf.setSize((int)numChannels, jmax(44100, (int)spec.maximumBlockSize), false, true, false);
+            rmsBuf.setSize((int)numChannels, numSamplesToRead, false, true, false);
         }
         else
         {
-            lPtr = 0;
-            rPtr = 0;
+            mainBuf.setSize(0, 0);
+            rmsBuf.setSize(0, 0);
         }
+
+        fifo.setTotalSize(numSamplesToRead);
+        levelFifo.reset();
+        queuedSums.assign(levelQueueSize * numChannels, 0.f);
+        pendingSums.assign(numChannels, 0.f);
+        pendingPeak = 0.f;
+        pendingNumSamples = 0;
+
+        blockMeanSquares.assign(numChannels, 0.f);
+        runningSum.assign(numChannels, 0.0);
+        if (sum.size() != numChannels)
+            sum = std::vector<std::atomic<float>>(numChannels);
+        for (auto &s : sum)
+            s = 0.f;
+
+        rmsSize = (rmsWindow * spec.sampleRate) / (float)spec.maximumBlockSize;
+        windowSize = (size_t)rmsSize;
+        window.assign(windowSize * numChannels, 0.f);
+
+        if (rmsSize > 1)
+            windowPos %= windowSize;
+        else
+            windowPos = 0;
     }
 
     void reset()
@@ -44,49 +75,43 @@ struct VolumeMeterSource : Timer
         mainBuf.clear();
         rmsBuf.clear();
         fifo.reset();
-        sum[0] = sum[1] = 0.f;
-        rmsvec[0].assign(rmsSize, 0.f);
-        rmsvec[1].assign(rmsSize, 0.f);
+        levelFifo.reset();
+        std::fill(pendingSums.begin(), pendingSums.end(), 0.f);
+        pendingPeak = 0.f;
+        pendingNumSamples = 0;
+        std::fill(runningSum.begin(), runningSum.end(), 0.0);
+        for (auto &s : sum)
+            s = 0.f;
+        std::fill(window.begin(), window.end(), 0.f);
     }
 
     // lock-free method for copying data to the meter's buffer
     template <typename T>
-    void copyBuffer(const T *const *buffer, size_t numChannels, size_t numSamples)
+    void copyBuffer(const T *const *buffer, size_t numBufferChannels, size_t numSamples)
     {
-        const auto scope = fifo.write(jmin((int)numSamples, fifo.getFreeSpace()));
-        if (scope.blockSize1 > 0)
+        if (mode == Mode::audioThread)
         {
-            mainBuf.copyFrom(0, scope.startIndex1, buffer[0], scope.blockSize1);
-            if (numChannels > 1)
-                mainBuf.copyFrom(1, scope.startIndex1, buffer[1], scope.blockSize1);
+            pushLevels(buffer, numBufferChannels, numSamples);
+            return;
         }
-        if (scope.blockSize2 > 0)
+
+        const auto numToCopy = jmin(numBufferChannels, numChannels);
+        const auto scope = fifo.write(jmin((int)numSamples, fifo.getFreeSpace()));
+        for (size_t ch = 0; ch < numToCopy; ++ch)
         {
-            mainBuf.copyFrom(0, scope.startIndex2, buffer[0], scope.blockSize2);
-            if (numChannels > 1)
-                mainBuf.copyFrom(1, scope.startIndex2, buffer[1], scope.blockSize2);
+            if (scope.blockSize1 > 0)
+                mainBuf.copyFrom((int)ch, scope.startIndex1, buffer[ch], scope.blockSize1);
+            if (scope.blockSize2 > 0)
+                mainBuf.copyFrom((int)ch, scope.startIndex2, buffer[ch] + scope.blockSize1, scope.blockSize2);
         }
+        numInputChannels = numToCopy;
         bufCopied = true;
     }
 
     // lock-free method for copying data to the meter's buffer
     void copyBuffer(const AudioBuffer<float> &_buffer)
     {
-        const auto numSamples = _buffer.getNumSamples();
-        const auto scope = fifo.write(jmin(numSamples, fifo.getFreeSpace()));
-        if (scope.blockSize1 > 0)
-        {
-            mainBuf.copyFrom(0, scope.startIndex1, _buffer, 0, 0, scope.blockSize1);
-            if (_buffer.getNumChannels() > 1)
-                mainBuf.copyFrom(1, scope.startIndex1, _buffer, 1, 0, scope.blockSize1);
-        }
-        if (scope.blockSize2 > 0)
-        {
-            mainBuf.copyFrom(0, scope.startIndex2, _buffer, 0, 0, scope.blockSize2);
-            if (_buffer.getNumChannels() > 1)
-                mainBuf.copyFrom(1, scope.startIndex2, _buffer, 1, 0, scope.blockSize2);
-        }
-        bufCopied = true;
+        copyBuffer(_buffer.getArrayOfReadPointers(), (size_t)_buffer.getNumChannels(), (size_t)_buffer.getNumSamples());
     }
 
     void measureBlock()
@@ -95,305 +120,467 @@ struct VolumeMeterSource : Timer
         if (numRead <= 0)
             return;
         const auto scope = fifo.read(numRead);
-        if (scope.blockSize1 > 0)
-        {
-            rmsBuf.copyFrom(0, 0, mainBuf, 0, scope.startIndex1, scope.blockSize1);
-            if (mainBuf.getNumChannels() > 1)
-                rmsBuf.copyFrom(1, 0, mainBuf, 1, scope.startIndex1, scope.blockSize1);
-        }
-        if (scope.blockSize2 > 0)
+        const auto numMeasured = jmin(numInputChannels.load(), numChannels);
+        float blockPeak = 0.f;
+
+        for (size_t ch = 0; ch < numMeasured; ++ch)
         {
-            rmsBuf.copyFrom(0, scope.blockSize1, mainBuf, 0, scope.startIndex2, scope.blockSize2);
-            if (mainBuf.getNumChannels() > 1)
-                rmsBuf.copyFrom(1, scope.blockSize1, mainBuf, 1, scope.startIndex2, scope.blockSize2);
+            if (scope.blockSize1 > 0)
+                rmsBuf.copyFrom((int)ch, 0, mainBuf, (int)ch, scope.startIndex1, scope.blockSize1);
+            if (scope.blockSize2 > 0)
+                rmsBuf.copyFrom((int)ch, scope.blockSize1, mainBuf, (int)ch, scope.startIndex2, scope.blockSize2);
+
+            float chPeak, chSum;
+            buffer_ops::peakAndSumOfSquares(rmsBuf.getReadPointer((int)ch), (size_t)numRead, chPeak, chSum);
+            blockPeak = jmax(blockPeak, chPeak);
+            blockMeanSquares[ch] = chSum / (float)numRead;
         }
 
-        peak = rmsBuf.getMagnitude(0, numRead);
+        fillMissingChannels(blockMeanSquares.data(), numMeasured);
 
-        rmsL = rmsBuf.getRMSLevel(0, 0, numRead);
-        rmsR = rmsL;
-        if (rmsBuf.getNumChannels() > 1)
-            rmsR = rmsBuf.getRMSLevel(1, 0, numRead);
+        peak = blockPeak;
+        pushMeanSquares(blockMeanSquares.data());
 
-        if (rmsvec[0].size() > 0)
+        newBuf = true;
+    }
+
+    /* Mode::audioThread: totals up the levels of the blocks that arrived since the last call,
+    and measures once a whole maximumBlockSize of samples has come in, like measureBlock() */
+    void measureLevels()
+    {
+        const auto scope = levelFifo.read(levelFifo.getNumReady());
+        scope.forEach([this](int index)
         {
-            rmsvec[0][lPtr] = rmsL * rmsL;
-            rmsvec[1][rPtr] = rmsR * rmsR;
-            lPtr = (lPtr + 1) % rmsvec[0].size();
-            rPtr = (rPtr + 1) % rmsvec[1].size();
-        }
-        else
+            const auto *sums = queuedSums.data() + (size_t)index * numChannels;
+            for (size_t ch = 0; ch < numChannels; ++ch)
+                pendingSums[ch] += sums[ch];
+
+            pendingPeak = jmax(pendingPeak, queuedPeaks[(size_t)index]);
+            pendingNumSamples += queuedNumSamples[(size_t)index];
+        });
+
+        if (pendingNumSamples < jmax(1, numSamplesToRead))
+            return;
+
+        const auto scale = 1.f / (float)pendingNumSamples;
+        for (size_t ch = 0; ch < numChannels; ++ch)
         {
-            sum[0] = rmsL * rmsL;
-            sum[1] = rmsR * rmsR;
+            blockMeanSquares[ch] = pendingSums[ch] * scale;
+            pendingSums[ch] = 0.f;
         }
 
+        peak = pendingPeak;
+        pushMeanSquares(blockMeanSquares.data());
+        pendingPeak = 0.f;
+        pendingNumSamples = 0;
+
         newBuf = true;
     }
 
-    void timerCallback() override
+    /* reads whatever the audio thread has handed over since the last call */
+    void measure()
     {
         // std::unique_lock<std::mutex> lock (mutex);
         juce::ScopedTryLock lock(mutex);
-        if (bufCopied && lock.isLocked())
+        if (!lock.isLocked())
+            return;
+
+        if (mode == Mode::audioThread)
+        {
+            measureLevels();
+            return;
+        }
+
+        if (bufCopied)
         {
             measureBlock();
             bufCopied = false;
         }
     }
 
+    /* gain reduction goes in the first channel, the rest read as 0 */
     void measureGR(float newGR)
     {
+        juce::ScopedTryLock lock(mutex);
+        if (!lock.isLocked())
+            return;
+
         peak = newGR;
 
-        if (rmsvec[0].size() > 0)
-        {
-            rmsvec[0][lPtr] = newGR * newGR;
-            lPtr = (lPtr + 1) % rmsvec[0].size();
-        }
-        else
-            sum[0] = newGR * newGR;
+        std::fill(blockMeanSquares.begin(), blockMeanSquares.end(), 0.f);
+        blockMeanSquares[0] = newGR * newGR;
+        pushMeanSquares(blockMeanSquares.data());
 
         newBuf = true;
     }
 
+    /* average of every channel's RMS. Constant time, the window's mean square is kept up to
+    date as blocks are measured */
     inline float getAvgRMS() const
     {
-        if (rmsvec[0].size() > 0 && rmsvec[1].size() > 0)
-        {
-            float rmsL, rmsR;
-            rmsL = std::sqrt(std::accumulate(rmsvec[0].begin(), rmsvec[0].end(), 0.f) / (float)rmsvec[0].size());
-            rmsR = std::sqrt(std::accumulate(rmsvec[1].begin(), rmsvec[1].end(), 0.f) / (float)rmsvec[1].size());
-            return (rmsL + rmsR) / 2.f;
-        }
+        const juce::ScopedLock lock(mutex);
+        float total = 0.f;
+        for (const auto &s : sum)
+            total += std::sqrt(s.load());
 
-        return (std::sqrt(sum[0]) + std::sqrt(sum[1])) / 2.f;
+        return total / (float)sum.size();
     }
 
     inline float getAvgRMS(int ch) const
     {
-        if (rmsvec[ch].size() > 0)
-            return std::sqrt(std::accumulate(rmsvec[ch].begin(), rmsvec[ch].end(), 0.f) / (float)rmsvec[ch].size());
+        const juce::ScopedLock lock(mutex);
+        jassert((size_t)ch < sum.size());
+        return std::sqrt(sum[(size_t)ch]);
+    }
 
-        return std::sqrt(sum[ch]);
+    size_t getNumChannels() const
+    {
+        const juce::ScopedLock lock(mutex);
+        return numChannels;
     }
 
     float peak = 0.f;
     std::atomic<bool> newBuf = false, bufCopied = false;
 
 private:
-    AbstractFifo fifo{1024};
-    AudioBuffer<float> mainBuf, rmsBuf;
-    int numSamplesToRead = 0;
+    friend class MeterRefreshHub;
+    uint32_t lastHubTick = 0; // so sources shared by several meters are measured once per tick
 
-    juce::CriticalSection mutex;
+    static constexpr size_t levelQueueSize = 128;
 
-    float rmsSize = 0.f;
-    float rmsL = 0.f, rmsR = 0.f;
-    std::vector<float> rmsvec[2];
-    size_t lPtr = 0, rPtr = 0;
-    std::atomic<float> sum[2];
-};
+    /* a mono block is metered on every channel, otherwise channels the block didn't have are silent */
+    void fillMissingChannels(float *values, size_t numFilled)
+    {
+        const auto fill = numFilled == 1 ? values[0] : 0.f;
+        for (size_t ch = numFilled; ch < numChannels; ++ch)
+            values[ch] = fill;
+    }
 
-struct VolumeMeterComponent : Component, Timer
-{
-    enum
+    template <typename T>
+    void pushLevels(const T *const *buffer, size_t numBufferChannels, size_t numSamples)
     {
-        Reduction = 1,       // 0 - Volume | 1 - Reduction
-        Horizontal = 1 << 1, // 0 - Vertical | 1 - Horizontal
-        ClipIndicator = 1 << 2,
-        Background = 1 << 3 // 0 - No background | 1 - draw a background
-    };
-    typedef uint8_t Flags;
+        if (numBufferChannels == 0 || numSamples == 0)
+            return;
 
-    Colour meterColor, backgroundColor;
+        // if the message thread's fallen behind, drop the block, like copyBuffer() drops samples
+        const auto scope = levelFifo.write(jmin(1, levelFifo.getFreeSpace()));
+        if (scope.blockSize1 == 0)
+            return;
 
-    /**
-     * @param v audio source for the meter
-     * @param s parameter the meter may be attached to (like a compression param, for instance). Used for turning the display on/off
-     */
-    VolumeMeterComponent(VolumeMeterSource &v, Flags f, int refreshRate, std::atomic<float> *s = nullptr) : source(v), state(s), flags(f)
-    {
-        startTimerHz(refreshRate);
-    }
+        const auto index = (size_t)scope.startIndex1;
+        auto *sums = queuedSums.data() + index * numChannels;
+        const auto numMeasured = jmin(numBufferChannels, numChannels);
+        float blockPeak = 0.f;
 
-    ~VolumeMeterComponent() override
-    {
-        stopTimer();
+        for (size_t ch = 0; ch < numMeasured; ++ch)
+        {
+            T chPeak, chSum;
+            buffer_ops::peakAndSumOfSquares(buffer[ch], numSamples, chPeak, chSum);
+            blockPeak = jmax(blockPeak, (float)chPeak);
+            sums[ch] = (float)chSum;
+        }
+
+        fillMissingChannels(sums, numMeasured);
+        queuedPeaks[index] = blockPeak;
+        queuedNumSamples[index] = (int)numSamples;
     }
 
-    void paint(Graphics &g) override
+    /* writes a block's mean squares into the window, swapping them for the oldest ones in the
+    running totals instead of summing the whole window again */
+    void pushMeanSquares(const float *meanSquares)
     {
-        switch (flags & Reduction)
+        if (windowSize == 0)
         {
-        case 0: // Volume
+            for (size_t ch = 0; ch < numChannels; ++ch)
+                sum[ch] = meanSquares[ch];
+            return;
+        }
+
+        auto *slot = window.data() + windowPos * numChannels;
+        for (size_t ch = 0; ch < numChannels; ++ch)
         {
-            if (isMouseButtonDown() || numTicks >= 150)
-            {
-                lastPeak = -90.f;
-                numTicks = 0;
-            }
+            runningSum[ch] += (double)meanSquares[ch] - (double)slot[ch];
+            slot[ch] = meanSquares[ch];
+        }
 
-            auto dbL = Decibels::gainToDecibels(source.getAvgRMS(0), -100.f);
-            auto dbR = Decibels::gainToDecibels(source.getAvgRMS(1), -100.f);
+        if (++windowPos == windowSize)
+        {
+            windowPos = 0;
+            // re-add the window once per lap so rounding errors can't pile up
+            std::fill(runningSum.begin(), runningSum.end(), 0.0);
+            for (size_t i = 0; i < windowSize; ++i)
+                for (size_t ch = 0; ch < numChannels; ++ch)
+                    runningSum[ch] += (double)window[i * numChannels + ch];
+        }
 
-            auto peak = Decibels::gainToDecibels(source.peak, -100.f);
+        for (size_t ch = 0; ch < numChannels; ++ch)
+            sum[ch] = (float)jmax(0.0, runningSum[ch] / (double)windowSize);
+    }
 
-            auto ob = getLocalBounds().withTrimmedTop(getHeight() * 0.1f);
+    Mode mode = Mode::copySamples;
+    size_t numChannels = 2;
+    std::atomic<size_t> numInputChannels = 0;
 
-            g.setColour(Colours::white);
-            g.fillRoundedRectangle((float)(ob.getCentreX() - 1), (float)ob.getY(), 2.f, (float)ob.getHeight(), 2.5f);
+    AbstractFifo fifo{1024};
+    AudioBuffer<float> mainBuf, rmsBuf;
+    int numSamplesToRead = 0;
 
-            auto bounds = Rectangle<float>{(float)ob.getX(), (float)ob.getY() + 4.f,
-                                           (float)ob.getRight() - ob.getX(),
-                                           (float)ob.getBottom() - ob.getY() - 2.f};
+    /* Mode::audioThread: per-block levels handed from the audio thread to the timer, and the
+    levels read so far until there's a block's worth */
+    AbstractFifo levelFifo{(int)levelQueueSize};
+    std::array<float, levelQueueSize> queuedPeaks{};
+    std::array<int, levelQueueSize> queuedNumSamples{};
+    std::vector<float> queuedSums; // levelQueueSize * numChannels
+    std::vector<float> pendingSums;
+    float pendingPeak = 0.f;
+    int pendingNumSamples = 0;
 
-            bounds.reduce(4.f, 4.f);
+    juce::CriticalSection mutex;
 
-            /*RMS meter*/
+    float rmsSize = 0.f;
+    std::vector<float> blockMeanSquares = std::vector<float>(2);
+    std::vector<float> window; // windowSize blocks of numChannels mean squares
+    size_t windowSize = 0, windowPos = 0;
+    std::vector<double> runningSum;
+    std::vector<std::atomic<float>> sum = std::vector<std::atomic<float>>(2); // mean square over the window, or of the last block without one
+};
 
-            Rectangle<float> rectL = bounds.withTop(bounds.getY() + jmax(dbL * bounds.getHeight() / -100.f, 0.f)).removeFromLeft(bounds.getWidth() / 2.f - 3.f);
-            Rectangle<float> rectR = bounds.withTop(bounds.getY() + jmax(dbR * bounds.getHeight() / -100.f, 0.f)).removeFromRight(bounds.getWidth() / 2.f - 3.f);
+/**
+ * Drives every meter in the process from one callback, synced to the display's vblank,
+ * instead of a Timer per source & component. It's shared through SharedResourcePointer, so
+ * it only exists while something is attached to it.
+ *
+ * Each tick, the source of every attachment whose component is on screen is measured (once,
+ * however many components share it), and then those components refresh. Attachments in
+ * closed or hidden windows are skipped. When nothing is on screen, the vblank callback is
+ * detached. If meters still exist but are hidden, a 2Hz timer watches for them to come back.
+ * Message thread only.
+ */
+class MeterRefreshHub : Timer
+{
+public:
+    /* Keeps a component (and the source it displays, if any) refreshed by the hub for as long
+    as the attachment exists */
+    class Attachment : ComponentListener
+    {
+    public:
+        Attachment(Component &componentToRefresh, VolumeMeterSource *sourceToMeasure, std::function<void()> onRefresh)
+            : component(componentToRefresh), source(sourceToMeasure), refresh(std::move(onRefresh))
+        {
+            component.addComponentListener(this);
+            hub->add(this);
+        }
 
-            g.setColour(meterColor);
+        ~Attachment() override
+        {
+            component.removeComponentListener(this);
+            hub->remove(this);
+        }
 
-            g.fillRect(rectL);
-            g.fillRect(rectR);
+    private:
+        friend class MeterRefreshHub;
 
-            /*peak ticks*/
+        /* on screen, or hidden itself (i.e. faded out) inside something that is */
+        bool isOnScreen() const
+        {
+            if (component.getPeer() == nullptr)
+                return false;
 
-            if (lastPeak > peak)
-            {
-                if (lastPeak > 0.f && (flags & ClipIndicator))
-                    g.setColour(Colours::red);
-                else
-                    g.setColour(Colours::white);
+            auto *parent = component.getParentComponent();
+            return component.isShowing() || (parent != nullptr && parent->isShowing());
+        }
 
-                g.drawHorizontalLine((int)bounds.getY() + jmax(lastPeak * bounds.getHeight() / -100.f, 0.f), bounds.getX(), bounds.getRight());
+        void componentVisibilityChanged(Component &) override { hub->updateAnchor(); }
+        void componentParentHierarchyChanged(Component &) override { hub->updateAnchor(); }
 
-                g.drawFittedText(String(lastPeak, 1) + "dB", getLocalBounds().removeFromTop(getHeight() * 0.1f), Justification::centred, 1);
-            }
-            else
-            {
-                if (peak > 0.f && (flags & ClipIndicator))
-                    g.setColour(Colours::red);
-                else
-                    g.setColour(Colours::white);
+        Component &component;
+        VolumeMeterSource *source;
+        std::function<void()> refresh;
+        SharedResourcePointer<MeterRefreshHub> hub;
+    };
 
-                g.drawHorizontalLine((int)bounds.getY() + jmax(peak * bounds.getHeight() / -100.f, 0.f), bounds.getX(), bounds.getRight());
+    ~MeterRefreshHub() override { stopTimer(); }
 
-                g.drawFittedText(String(peak, 1) + "dB", getLocalBounds().removeFromTop(getHeight() * 0.1f), Justification::centred, 1);
+private:
+    void add(Attachment *attachment)
+    {
+        JUCE_ASSERT_MESSAGE_THREAD
+        attachments.push_back(attachment);
+        updateAnchor();
+    }
 
-                lastPeak = peak;
-            }
-            break;
+    void remove(Attachment *attachment)
+    {
+        JUCE_ASSERT_MESSAGE_THREAD
+        attachments.erase(std::remove(attachments.begin(), attachments.end(), attachment), attachments.end());
+
+        if (anchor == attachment)
+            anchor = nullptr;
+
+        updateAnchor();
+    }
+
+    /* The vblank callback has to hang off a component on screen, so this keeps it attached
+    to one of them, or detaches it if there are none. Re-attaching destroys the current
+    callback, so from inside a tick it's left to the timer on the next message loop */
+    void updateAnchor()
+    {
+        if (anchor != nullptr && anchor->isOnScreen())
+        {
+            // a tick may have left the 1 ms timer running while the anchor was off screen
+            if (!ticking)
+                stopTimer();
+            return;
         }
-        case 1: // Reduction
+
+        if (ticking)
         {
-            float maxDb = 24.f;  // max dB the meter can display
-            float padding = 0.f; // padding for the "GR" label
-            if (isMouseButtonDown() || numTicks >= 225)
+            startTimer(1);
+            return;
+        }
+
+        vblank.reset();
+        anchor = nullptr;
+
+        for (auto *a : attachments)
+        {
+            if (a->isOnScreen())
             {
-                numTicks = 0;
-                lastPeak = 0.f;
+                anchor = a;
+                vblank = std::make_unique<VBlankAttachment>(&a->component, [this] { tick(); });
+                break;
             }
+        }
 
-            auto db = Decibels::gainToDecibels(source.getAvgRMS(), -60.f);
-            auto peak = Decibels::gainToDecibels(source.peak, -60.f);
+        if (anchor == nullptr && !attachments.empty())
+            startTimerHz(2);
+        else
+            stopTimer();
+    }
+
+    void tick()
+    {
+        if (anchor == nullptr || !anchor->isOnScreen())
+        {
+            startTimer(1);
+            return;
+        }
 
-            auto ob = getLocalBounds();
-            auto bounds = Rectangle<float>{ceilf(ob.getX()), ceilf(ob.getY()) + 1.f,
-                                           floorf(ob.getRight()) - ceilf(ob.getX()) + 2.f, floorf(ob.getBottom()) - ceilf(ob.getY()) + 2.f};
+        const ScopedValueSetter<bool> inTick(ticking, true);
+        ++tickCount;
 
-            if (flags & Background)
+        for (auto *a : attachments)
+        {
+            if (a->source != nullptr && a->source->lastHubTick != tickCount && a->isOnScreen())
             {
-                g.setColour(backgroundColor);
-                g.fillRoundedRectangle(bounds.reduced(2.f), 5.f);
+                a->source->lastHubTick = tickCount;
+                a->source->measure();
             }
+        }
 
-            bounds.reduce(4.f, 4.f);
+        // by index, in case a refresh ends up adding or removing an attachment
+        for (size_t i = 0; i < attachments.size(); ++i)
+            if (attachments[i]->isOnScreen())
+                attachments[i]->refresh();
+    }
 
-            g.setColour(meterColor);
-            if (!(flags & Horizontal)) // INCOMPLETE: Vertical
-            {
-                maxDb = 36.f;
-                padding = 15.f;
-                db = jmax(db, -maxDb + 3.f);
-                Rectangle<float> rect = bounds.withBottom(bounds.getY() - db * bounds.getHeight() / maxDb);
-
-                g.fillRect(rect.translated(0, padding));
-                g.drawFittedText("GR", Rectangle<int>(0, 0, ob.getWidth(), padding * 0.75f), Justification::centred, 1);
-
-                /* peak tick */
-                if (peak < lastPeak)
-                {
-                    peak = jmax(peak, -maxDb + 3.f);
-                    g.fillRect(bounds.getX(), (bounds.getY() - peak * bounds.getHeight() / maxDb) + padding, bounds.getWidth(), 2.f);
-                    lastPeak = peak;
-                }
-                else
-                    g.fillRect(bounds.getX(), (bounds.getY() - lastPeak * bounds.getHeight() / maxDb) + padding, bounds.getWidth(), 2.f);
-
-                /* meter scale ticks */
-                // for (float i = 0; i <= bounds.getHeight(); i += bounds.getHeight() / 6.f)
-                // {
-                //     if (i > 0)
-                //         g.fillRect(0.f, i + padding, 4.f, 2.f);
-                //     g.setFont(8.f);
-                //     g.drawFittedText(String((i / bounds.getHeight()) * maxDb), Rectangle<int>(0, i, 10, 10), Justification::centred, 1);
-                // }
-            }
-            else // Horizontal
-            {
-                maxDb = 24.f;
-                padding = 30.f; // space for meter values (if printing them. Must uncomment uses below!)
-                float topTrim = 10.f;
-                db = jmax(db, -maxDb + 3.f);
-                Rectangle<float> rect = bounds.withRight(bounds.getX() - db * bounds.getWidth() / maxDb).withTrimmedTop(topTrim);
+    void timerCallback() override { updateAnchor(); }
 
-                g.fillRect(rect);
+    std::vector<Attachment *> attachments;
+    Attachment *anchor = nullptr;
+    std::unique_ptr<VBlankAttachment> vblank;
+    uint32_t tickCount = 0;
+    bool ticking = false;
+};
 
-#ifdef TEST_METER_VALUES
-                g.setColour(Colours::red);
-                g.drawFittedText(String(String((int)std::abs(lastPeak)) + "/" + String((int)std::abs(db))), Rectangle<int>(0, 0, padding, ob.getHeight()), Justification::centred, 1);
-                g.setColour(meterColor);
-#endif
+struct VolumeMeterComponent : Component
+{
+    enum
+    {
+        Reduction = 1,       // 0 - Volume | 1 - Reduction
+        Horizontal = 1 << 1, // 0 - Vertical | 1 - Horizontal
+        ClipIndicator = 1 << 2,
+        Background = 1 << 3 // 0 - No background | 1 - draw a background
+    };
+    typedef uint8_t Flags;
 
-                if (peak < lastPeak && peak != 0.f)
-                {
-                    peak = jmax(peak, -maxDb + 3.f);
-                    g.fillRect((bounds.getX() - peak * bounds.getWidth() / maxDb) /*  + padding */, rect.getY(), 2.f, rect.getHeight());
-                    lastPeak = peak;
-                }
-                else if (lastPeak != 0.f)
-                    g.fillRect((bounds.getX() - lastPeak * bounds.getWidth() / maxDb) /*  + padding */, rect.getY(), 2.f, rect.getHeight());
-
-                /* ticks & numbers */
-                const float nWidth = bounds.getWidth() /*  - padding */;
-                for (float i = 0; i + topTrim + 5 <= bounds.getRight(); i += nWidth / 6.f)
-                {
-                    g.setFont(topTrim);
-                    String str = "| ";
-                    str.append(String(static_cast<int>((i / nWidth) * maxDb)), 2);
-                    g.drawText(str, Rectangle<int>(bounds.getX() + i - 1, bounds.getY(), (int)topTrim + 5, (int)topTrim), Justification::centred);
-                }
-            }
-            if (getState() && !*getState()) /*reset peak if comp is turned off*/
-                lastPeak = 0.f;
-            break;
+    Colour meterColor, backgroundColor;
+
+    /**
+     * @param v audio source for the meter
+     * @param refreshRate max refresh rate in Hz, the MeterRefreshHub runs at the display's rate
+     * @param s parameter the meter may be attached to (like a compression param, for instance). Used for turning the display on/off
+     */
+    VolumeMeterComponent(VolumeMeterSource &v, Flags f, int refreshRate, std::atomic<float> *s = nullptr)
+        : source(v), state(s), flags(f), minRefreshIntervalMs(refreshRate > 0 ? 900.0 / refreshRate : 0.0)
+    {
+    }
+
+    /* The background, scale & labels never change at a given size, so they're drawn once into
+    an image, and each frame only draws the bars & peak tick on top of it */
+    void paint(Graphics &g) override
+    {
+        const auto scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+        if (staticLayer.isNull() || scale != cachedScale || meterColor != cachedMeterColor || backgroundColor != cachedBackgroundColor)
+            renderStaticLayer(scale);
+
+        g.drawImage(staticLayer, getLocalBounds().toFloat());
+
+        g.setColour(meterColor);
+        g.fillRect(frame.barL);
+        g.fillRect(frame.barR);
+
+        if (!frame.peakTick.isEmpty())
+        {
+            g.setColour(frame.peakColour);
+            g.fillRect(frame.peakTick);
         }
-        default:
-            return;
+
+        if (frame.peakText.isNotEmpty())
+            g.drawFittedText(frame.peakText, frame.peakLabel, Justification::centred, 1);
+
+#ifdef TEST_METER_VALUES
+        if (flags & Reduction && flags & Horizontal)
+        {
+            g.setColour(Colours::red);
+            g.drawFittedText(String(String((int)std::abs(lastPeak)) + "/" + String((int)std::abs(lastDb))), Rectangle<int>(0, 0, 30, getHeight()), Justification::centred, 1);
         }
+#endif
     }
 
-    void timerCallback() override
+    void resized() override
     {
+        staticLayer = {};
+        frame = layoutFrame();
+        repaint();
+    }
+
+    /* called by the MeterRefreshHub, once the source has been measured */
+    void refresh()
+    {
+        // a little under the interval, so a 60Hz meter on a 60Hz display doesn't skip frames
+        const auto now = Time::getMillisecondCounterHiRes();
+        if (now - lastRefreshMs < minRefreshIntervalMs)
+            return;
+        lastRefreshMs = now;
+
         if (source.newBuf)
         {
             source.newBuf = false;
-            repaint(getLocalBounds());
             ++numTicks;
+
+            // only what moved gets repainted, in both its old & new positions
+            const auto last = frame;
+            frame = layoutFrame();
+
+            repaintIfChanged(last.barL, frame.barL);
+            repaintIfChanged(last.barR, frame.barR);
+            repaintIfChanged(last.peakTick, frame.peakTick);
+            if (last.peakText != frame.peakText || last.peakColour != frame.peakColour)
+                repaint(frame.peakLabel);
+#ifdef TEST_METER_VALUES
+            repaint(0, 0, 30, getHeight());
+#endif
         }
 
         if (flags & Reduction)
@@ -416,12 +603,185 @@ struct VolumeMeterComponent : Component, Timer
     void setState(std::atomic<float> *newState) { state = newState; }
 
 private:
+    /* the parts of the meter that move */
+    struct Frame
+    {
+        Rectangle<float> barL, barR, peakTick;
+        Rectangle<int> peakLabel;
+        String peakText;
+        Colour peakColour;
+    };
+
+    void repaintIfChanged(Rectangle<float> before, Rectangle<float> after)
+    {
+        if (before != after)
+            repaint(before.getUnion(after).getSmallestIntegerContainer().expanded(1));
+    }
+
+    /* Volume mode's meter area, below the peak label */
+    Rectangle<float> volumeBounds() const
+    {
+        auto ob = getLocalBounds().withTrimmedTop(getHeight() * 0.1f);
+        auto bounds = Rectangle<float>{(float)ob.getX(), (float)ob.getY() + 4.f,
+                                       (float)ob.getRight() - ob.getX(),
+                                       (float)ob.getBottom() - ob.getY() - 2.f};
+        return bounds.reduced(4.f, 4.f);
+    }
+
+    /* Reduction mode's outline, before it's inset for the meter */
+    Rectangle<float> reductionOutline() const
+    {
+        auto ob = getLocalBounds();
+        return {ceilf(ob.getX()), ceilf(ob.getY()) + 1.f,
+                floorf(ob.getRight()) - ceilf(ob.getX()) + 2.f, floorf(ob.getBottom()) - ceilf(ob.getY()) + 2.f};
+    }
+
+    void renderStaticLayer(float scale)
+    {
+        cachedScale = scale;
+        cachedMeterColor = meterColor;
+        cachedBackgroundColor = backgroundColor;
+
+        const auto w = jmax(1, roundToInt(getWidth() * scale)), h = jmax(1, roundToInt(getHeight() * scale));
+        staticLayer = Image(Image::ARGB, w, h, true);
+
+        Graphics g(staticLayer);
+        g.addTransform(AffineTransform::scale(scale));
+
+        if (!(flags & Reduction))
+        {
+            auto ob = getLocalBounds().withTrimmedTop(getHeight() * 0.1f);
+            g.setColour(Colours::white);
+            g.fillRoundedRectangle((float)(ob.getCentreX() - 1), (float)ob.getY(), 2.f, (float)ob.getHeight(), 2.5f);
+            return;
+        }
+
+        auto ob = getLocalBounds();
+        auto bounds = reductionOutline();
+
+        if (flags & Background)
+        {
+            g.setColour(backgroundColor);
+            g.fillRoundedRectangle(bounds.reduced(2.f), 5.f);
+        }
+
+        bounds.reduce(4.f, 4.f);
+        g.setColour(meterColor);
+
+        if (!(flags & Horizontal))
+        {
+            const float padding = 15.f;
+            g.drawFittedText("GR", Rectangle<int>(0, 0, ob.getWidth(), padding * 0.75f), Justification::centred, 1);
+        }
+        else
+        {
+            /* ticks & numbers */
+            const float maxDb = 24.f, topTrim = 10.f;
+            const float nWidth = bounds.getWidth();
+            for (float i = 0; i + topTrim + 5 <= bounds.getRight(); i += nWidth / 6.f)
+            {
+                g.setFont(topTrim);
+                String str = "| ";
+                str.append(String(static_cast<int>((i / nWidth) * maxDb)), 2);
+                g.drawText(str, Rectangle<int>(bounds.getX() + i - 1, bounds.getY(), (int)topTrim + 5, (int)topTrim), Justification::centred);
+            }
+        }
+    }
+
+    /* reads the source & works out the bars & peak hold for this frame */
+    Frame layoutFrame()
+    {
+        Frame f;
+
+        if (!(flags & Reduction))
+        {
+            if (isMouseButtonDown() || numTicks >= 150)
+            {
+                lastPeak = -90.f;
+                numTicks = 0;
+            }
+
+            auto dbL = Decibels::gainToDecibels(source.getAvgRMS(0), -100.f);
+            auto dbR = Decibels::gainToDecibels(source.getAvgRMS(1), -100.f);
+            auto peak = Decibels::gainToDecibels(source.peak, -100.f);
+
+            const auto bounds = volumeBounds();
+
+            /*RMS meter*/
+            f.barL = bounds.withTop(bounds.getY() + jmax(dbL * bounds.getHeight() / -100.f, 0.f)).removeFromLeft(bounds.getWidth() / 2.f - 3.f);
+            f.barR = bounds.withTop(bounds.getY() + jmax(dbR * bounds.getHeight() / -100.f, 0.f)).removeFromRight(bounds.getWidth() / 2.f - 3.f);
+
+            /*peak ticks*/
+            if (lastPeak <= peak)
+                lastPeak = peak;
+
+            f.peakColour = lastPeak > 0.f && (flags & ClipIndicator) ? Colours::red : Colours::white;
+            f.peakTick = {bounds.getX(), (float)(int)(bounds.getY() + jmax(lastPeak * bounds.getHeight() / -100.f, 0.f)), bounds.getWidth(), 1.f};
+            f.peakLabel = getLocalBounds().removeFromTop(getHeight() * 0.1f);
+            f.peakText = String(lastPeak, 1) + "dB";
+
+            return f;
+        }
+
+        if (isMouseButtonDown() || numTicks >= 225)
+        {
+            numTicks = 0;
+            lastPeak = 0.f;
+        }
+
+        auto db = Decibels::gainToDecibels(source.getAvgRMS(), -60.f);
+        auto peak = Decibels::gainToDecibels(source.peak, -60.f);
+
+        auto bounds = reductionOutline().reduced(4.f, 4.f);
+        f.peakColour = meterColor;
+
+        if (!(flags & Horizontal)) // INCOMPLETE: Vertical
+        {
+            const float maxDb = 36.f, padding = 15.f;
+            db = jmax(db, -maxDb + 3.f);
+            f.barL = bounds.withBottom(bounds.getY() - db * bounds.getHeight() / maxDb).translated(0, padding);
+
+            /* peak tick */
+            if (peak < lastPeak)
+                lastPeak = jmax(peak, -maxDb + 3.f);
+
+            f.peakTick = {bounds.getX(), (bounds.getY() - lastPeak * bounds.getHeight() / maxDb) + padding, bounds.getWidth(), 2.f};
+        }
+        else // Horizontal
+        {
+            const float maxDb = 24.f, topTrim = 10.f;
+            db = jmax(db, -maxDb + 3.f);
+            f.barL = bounds.withRight(bounds.getX() - db * bounds.getWidth() / maxDb).withTrimmedTop(topTrim);
+
+            if (peak < lastPeak && peak != 0.f)
+                lastPeak = jmax(peak, -maxDb + 3.f);
+
+            if (lastPeak != 0.f)
+                f.peakTick = {bounds.getX() - lastPeak * bounds.getWidth() / maxDb, f.barL.getY(), 2.f, f.barL.getHeight()};
+        }
+
+        lastDb = db;
+
+        if (getState() && !*getState()) /*reset peak if comp is turned off*/
+            lastPeak = 0.f;
+
+        return f;
+    }
+
     VolumeMeterSource &source;
     int numTicks = 0;
     Flags flags;
     std::atomic<float> *state;
     bool lastState = false;
-    float lastPeak = 0.f;
+    float lastPeak = 0.f, lastDb = 0.f;
+
+    Frame frame;
+    Image staticLayer;
+    float cachedScale = 0.f;
+    Colour cachedMeterColor, cachedBackgroundColor;
+
+    double minRefreshIntervalMs, lastRefreshMs = 0.0;
 
     ComponentAnimator anim;
-};
\ No newline at end of file
+    MeterRefreshHub::Attachment hubAttachment{*this, &source, [this] { refresh(); }};
+};
@@ -0,0 +1,18 @@
+/* Dispatch_avx2.cpp
+Instantiates the dispatch kernels for avx2. Must be compiled with -mavx2
+(see the arbor_dispatch target in CMakeLists.txt). Only instantiate code templated on the
+arch here, see the note at the top of Dispatch.h */
+
+#include <cstddef>
+#include "../../xsimd/include/xsimd/xsimd.hpp"
+
+#define STRIX_RUNTIME_DISPATCH 1
+
+namespace strix
+{
+#include "../FastMath.h"
+#include "../Dispatch.h"
+
+template struct dispatch::Kernels<xsimd::avx2, float>;
+template struct dispatch::Kernels<xsimd::avx2, double>;
+}
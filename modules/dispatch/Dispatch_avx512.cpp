@@ -0,0 +1,18 @@
+/* Dispatch_avx512.cpp
+Instantiates the dispatch kernels for avx512f. Must be compiled with -mavx512f
+(see the arbor_dispatch target in CMakeLists.txt). Only instantiate code templated on the
+arch here, see the note at the top of Dispatch.h */
+
+#include <cstddef>
+#include "../../xsimd/include/xsimd/xsimd.hpp"
+
+#define STRIX_RUNTIME_DISPATCH 1
+
+namespace strix
+{
+#include "../FastMath.h"
+#include "../Dispatch.h"
+
+template struct dispatch::Kernels<xsimd::avx512f, float>;
+template struct dispatch::Kernels<xsimd::avx512f, double>;
+}
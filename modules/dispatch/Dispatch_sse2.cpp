@@ -0,0 +1,17 @@
+/* Dispatch_sse2.cpp
+Instantiates the dispatch kernels for sse2. Must be compiled with -msse2
+(see the arbor_dispatch target in CMakeLists.txt) */
+
+#include <cstddef>
+#include "../../xsimd/include/xsimd/xsimd.hpp"
+
+#define STRIX_RUNTIME_DISPATCH 1
+
+namespace strix
+{
+#include "../FastMath.h"
+#include "../Dispatch.h"
+
+template struct dispatch::Kernels<xsimd::sse2, float>;
+template struct dispatch::Kernels<xsimd::sse2, double>;
+}